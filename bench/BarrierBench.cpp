@@ -0,0 +1,32 @@
+/**
+ * Measures the latency of the workers' barrier: the time for all the threads to cross it once.
+ */
+#include "BenchUtil.h"
+#include "../include/Barrier.h"
+#include <thread>
+
+#define ROUNDS 20000
+
+int main() {
+    for (const int threads : {2, 4, 8}) {
+        std::vector<double> nanos;
+        for (int run = 0; run < BENCH_RUNS; ++run) {
+            Barrier barrier(threads);
+            std::vector<std::thread> workers;
+            const int64_t start = benchNanos();
+            for (int i = 0; i < threads; ++i) {
+                workers.emplace_back([&barrier] {
+                    for (int round = 0; round < ROUNDS; ++round) {
+                        barrier.barrier();
+                    }
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            nanos.push_back(static_cast<double>(benchNanos() - start));
+        }
+        printResult("barrier", {{"threads", std::to_string(threads)}}, ROUNDS, nanos);
+    }
+    return 0;
+}
@@ -0,0 +1,162 @@
+#ifndef BENCHUTIL_H
+#define BENCHUTIL_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../include/MapReduceFramework.h"
+
+#define BENCH_RUNS 5 // Runs of every configuration, of which the median and the minimum are reported
+#define KEY_POOL_SIZE 1024 // Distinct keys emitted by the benchmarks that do not vary the key count
+
+/**
+ * An integer key, which is cheap to compare.
+ */
+class IntKey final : public K2, public K3 {
+public:
+    explicit IntKey(const int value) : value(value) {}
+
+    bool operator<(const K2& other) const override {
+        return value < static_cast<const IntKey&>(other).value;
+    }
+
+    int compare(const K2& other) const override {
+        const int otherValue = static_cast<const IntKey&>(other).value;
+        return (value > otherValue) - (value < otherValue);
+    }
+
+    bool operator<(const K3& other) const override {
+        return value < static_cast<const IntKey&>(other).value;
+    }
+
+    int value;
+};
+
+/**
+ * A string key, whose comparisons cost more the longer the common prefix of the keys is.
+ */
+class StringKey final : public K2 {
+public:
+    explicit StringKey(std::string value) : value(std::move(value)) {}
+
+    bool operator<(const K2& other) const override {
+        return value < static_cast<const StringKey&>(other).value;
+    }
+
+    int compare(const K2& other) const override {
+        return value.compare(static_cast<const StringKey&>(other).value);
+    }
+
+    std::string value;
+};
+
+/**
+ * The input value of the benchmarks: the index of the input pair.
+ */
+class IndexValue final : public V1 {
+public:
+    explicit IndexValue(const int index) : index(index) {}
+
+    int index;
+};
+
+/**
+ * A client whose keys are owned by the benchmark rather than by the pairs, so the measured phases
+ * do not allocate or free anything. Map and reduce do nothing unless overridden.
+ */
+class BenchClient : public MapReduceClient {
+public:
+    void map(const K1*, const V1*, void*) const override {}
+
+    void reduce(const IntermediateVec*, void*) const override {}
+
+    void releaseIntermediate(K2*, V2*) const override {}
+};
+
+/**
+ * Creates the input of a benchmark.
+ * @param size The number of input pairs.
+ * @return Input pairs whose values are their indices.
+ */
+inline InputVec makeBenchInput(const int size) {
+    InputVec input;
+    input.reserve(size);
+    for (int i = 0; i < size; ++i) {
+        input.emplace_back(nullptr, new IndexValue(i));
+    }
+    return input;
+}
+
+/**
+ * Frees the input of a benchmark.
+ * @param input The input pairs.
+ */
+inline void freeBenchInput(InputVec& input) {
+    for (auto& [key, value] : input) {
+        delete value;
+    }
+    input.clear();
+}
+
+/**
+ * Runs a job to completion with the phases measured.
+ * @param client The client of the job.
+ * @param input The input pairs.
+ * @param config The configuration of the job, on which perfCounters is set.
+ * @param stats Set to the statistics of the job.
+ * @return The output of the job.
+ */
+inline OutputVec runMeasuredJob(const MapReduceClient& client, const InputVec& input, JobConfig config,
+                                JobStats& stats) {
+    OutputVec output;
+    config.perfCounters = true;
+    JobHandle job = startMapReduceJob(client, input, output, config);
+    waitForJob(job);
+    getJobStats(job, &stats);
+    closeJobHandle(job);
+    return output;
+}
+
+/**
+ * @return The steady_clock time in nanoseconds.
+ */
+inline int64_t benchNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Prints the result of a benchmark configuration as a single JSON line:
+ * {"benchmark": ..., "params": {...}, "ops": ..., "runs": ..., "median_ns_per_op": ..., "min_ns_per_op": ...}
+ * @param benchmark The name of the benchmark.
+ * @param params The parameters of the configuration, as names and JSON values.
+ * @param ops The number of operations in a single run.
+ * @param nanos The total nanoseconds of every run.
+ */
+inline void printResult(const char* benchmark, const std::vector<std::pair<const char*, std::string>>& params,
+                        const uint64_t ops, std::vector<double> nanos) {
+    std::sort(nanos.begin(), nanos.end());
+    const double perOp = ops == 0 ? 0 : 1.0 / static_cast<double>(ops);
+    std::printf("{\"benchmark\": \"%s\", \"params\": {", benchmark);
+    for (size_t i = 0; i < params.size(); ++i) {
+        std::printf("%s\"%s\": %s", i == 0 ? "" : ", ", params[i].first, params[i].second.c_str());
+    }
+    std::printf("}, \"ops\": %llu, \"runs\": %zu, \"median_ns_per_op\": %.3f, \"min_ns_per_op\": %.3f}\n",
+                static_cast<unsigned long long>(ops), nanos.size(),
+                nanos[nanos.size() / 2] * perOp, nanos.front() * perOp);
+    std::fflush(stdout);
+}
+
+/**
+ * @param text A string.
+ * @return The string as a JSON value.
+ */
+inline std::string quoted(const std::string& text) {
+    return "\"" + text + "\"";
+}
+
+#endif //BENCHUTIL_H
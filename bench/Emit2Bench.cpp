@@ -0,0 +1,55 @@
+/**
+ * Measures the cost of emit2 for a single pair: a single worker maps a few input pairs, each of
+ * which emits many pairs with keys owned by the benchmark. The map phase time of a run without
+ * emits is subtracted, leaving the cost of the emits themselves.
+ */
+#include "BenchUtil.h"
+
+#define INPUT_PAIRS 16
+#define EMITS_PER_INPUT 65536
+
+static IntKey* keys[KEY_POOL_SIZE];
+
+class EmitClient final : public BenchClient {
+public:
+    explicit EmitClient(const int emits) : emits(emits) {}
+
+    void map(const K1*, const V1*, void* context) const override {
+        for (int i = 0; i < emits; ++i) {
+            emit2(keys[i % KEY_POOL_SIZE], nullptr, context);
+        }
+    }
+
+private:
+    const int emits;
+};
+
+/**
+ * @param emits The emits of every map call.
+ * @return The map phase time of a single-worker job.
+ */
+static double mapNanos(const int emits, const InputVec& input) {
+    EmitClient client(emits);
+    JobConfig config;
+    config.multiThreadLevel = 1;
+    JobStats stats;
+    runMeasuredJob(client, input, config, stats);
+    return static_cast<double>(stats.perfCounters[PERF_MAP].nanos);
+}
+
+int main() {
+    for (int i = 0; i < KEY_POOL_SIZE; ++i) {
+        keys[i] = new IntKey(i);
+    }
+    InputVec input = makeBenchInput(INPUT_PAIRS);
+    std::vector<double> nanos;
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        nanos.push_back(std::max(mapNanos(EMITS_PER_INPUT, input) - mapNanos(0, input), 0.0));
+    }
+    printResult("emit2", {{"threads", "1"}}, static_cast<uint64_t>(INPUT_PAIRS) * EMITS_PER_INPUT, nanos);
+    freeBenchInput(input);
+    for (IntKey* key : keys) {
+        delete key;
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+/**
+ * Measures the cost of emit3 under contention: every reduce call emits many output pairs, with
+ * the output vector's lock or with the output queue. Reported per output pair, as the workers'
+ * total reduce time divided by the number of output pairs.
+ */
+#include "BenchUtil.h"
+
+#define GROUPS 256
+#define EMITS_PER_GROUP 4096
+
+static IntKey* keys[GROUPS];
+
+/**
+ * A client which emits a distinct key for every input pair, and many output pairs for every group.
+ */
+class OutputClient final : public BenchClient {
+public:
+    void map(const K1*, const V1* value, void* context) const override {
+        emit2(keys[static_cast<const IndexValue*>(value)->index], nullptr, context);
+    }
+
+    void reduce(const IntermediateVec* pairs, void* context) const override {
+        auto* key = static_cast<IntKey*>(pairs->front().first);
+        for (int i = 0; i < EMITS_PER_GROUP; ++i) {
+            emit3(key, nullptr, context);
+        }
+    }
+};
+
+int main() {
+    for (int i = 0; i < GROUPS; ++i) {
+        keys[i] = new IntKey(i);
+    }
+    InputVec input = makeBenchInput(GROUPS);
+    const OutputClient client;
+    for (const bool outputQueue : {false, true}) {
+        for (const int threads : {1, 2, 4, 8}) {
+            JobConfig config;
+            config.multiThreadLevel = threads;
+            config.outputQueue = outputQueue;
+            std::vector<double> nanos;
+            for (int run = 0; run < BENCH_RUNS; ++run) {
+                JobStats stats;
+                runMeasuredJob(client, input, config, stats); // The output only holds borrowed keys
+                nanos.push_back(static_cast<double>(stats.perfCounters[PERF_REDUCE].nanos));
+            }
+            printResult("emit3", {{"threads", std::to_string(threads)},
+                                  {"output_queue", outputQueue ? "true" : "false"}},
+                        static_cast<uint64_t>(GROUPS) * EMITS_PER_GROUP, nanos);
+        }
+    }
+    freeBenchInput(input);
+    for (IntKey* key : keys) {
+        delete key;
+    }
+    return 0;
+}
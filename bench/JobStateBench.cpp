@@ -0,0 +1,67 @@
+/**
+ * Measures the cost of getJobState while a job is running, polled in a tight loop by a number of
+ * monitoring threads. Every poller makes a fixed number of calls, and the time of a call is the
+ * total time of the pollers over all their calls; the job's own run time is reported alongside,
+ * to show how much the polling slows the workers down.
+ */
+#include "BenchUtil.h"
+#include <atomic>
+#include <thread>
+
+#define INPUT_PAIRS (1 << 18)
+#define WORK_PER_INPUT 200 // Iterations of busy work in every map call
+#define POLLS_PER_POLLER (1 << 20) // getJobState calls made by every polling thread
+
+/**
+ * A client whose map calls do a little work and emit nothing.
+ */
+class BusyClient final : public BenchClient {
+public:
+    void map(const K1*, const V1* value, void*) const override {
+        volatile int sink = static_cast<const IndexValue*>(value)->index;
+        for (int i = 0; i < WORK_PER_INPUT; ++i) {
+            sink = sink * 31 + i;
+        }
+    }
+};
+
+int main() {
+    InputVec input = makeBenchInput(INPUT_PAIRS);
+    const BusyClient client;
+    for (const int pollers : {1, 2, 4}) {
+        std::vector<double> callNanos;
+        std::vector<double> jobNanos;
+        for (int run = 0; run < BENCH_RUNS; ++run) {
+            JobConfig config;
+            config.multiThreadLevel = 4;
+            OutputVec output;
+            std::atomic<int64_t> pollNanos(0);
+            const int64_t start = benchNanos();
+            JobHandle job = startMapReduceJob(client, input, output, config);
+            std::vector<std::thread> threads;
+            for (int i = 0; i < pollers; ++i) {
+                threads.emplace_back([&] {
+                    const int64_t pollStart = benchNanos();
+                    JobState state;
+                    for (int call = 0; call < POLLS_PER_POLLER; ++call) {
+                        getJobState(job, &state);
+                    }
+                    pollNanos.fetch_add(benchNanos() - pollStart);
+                });
+            }
+            waitForJob(job);
+            jobNanos.push_back(static_cast<double>(benchNanos() - start));
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            closeJobHandle(job);
+            callNanos.push_back(static_cast<double>(pollNanos.load()));
+        }
+        printResult("get_job_state", {{"pollers", std::to_string(pollers)}, {"workers", "4"}},
+                    static_cast<uint64_t>(pollers) * POLLS_PER_POLLER, callNanos);
+        printResult("get_job_state_job_time", {{"pollers", std::to_string(pollers)}, {"workers", "4"}},
+                    INPUT_PAIRS, jobNanos);
+    }
+    freeBenchInput(input);
+    return 0;
+}
@@ -0,0 +1,53 @@
+/**
+ * Measures the framework's overhead of handing a group to reduce: every group holds a single pair
+ * and reduce does nothing, so the reduce phase time is the cost of claiming and dispatching the
+ * groups. Reported per group, as the workers' total time divided by the number of groups.
+ */
+#include "BenchUtil.h"
+
+#define GROUPS (1 << 18)
+
+/**
+ * A client which emits a distinct key for every input pair.
+ */
+class DistinctClient final : public BenchClient {
+public:
+    explicit DistinctClient(const std::vector<IntKey*>& keys) : keys(keys) {}
+
+    void map(const K1*, const V1* value, void* context) const override {
+        emit2(keys[static_cast<const IndexValue*>(value)->index], nullptr, context);
+    }
+
+private:
+    const std::vector<IntKey*>& keys;
+};
+
+int main() {
+    InputVec input = makeBenchInput(GROUPS);
+    std::vector<IntKey*> keys;
+    for (int i = 0; i < GROUPS; ++i) {
+        keys.push_back(new IntKey(i));
+    }
+    const DistinctClient client(keys);
+    for (const bool streaming : {false, true}) {
+        for (const int threads : {1, 2, 4, 8}) {
+            JobConfig config;
+            config.multiThreadLevel = threads;
+            config.streamingReduce = streaming;
+            std::vector<double> nanos;
+            for (int run = 0; run < BENCH_RUNS; ++run) {
+                JobStats stats;
+                runMeasuredJob(client, input, config, stats);
+                nanos.push_back(static_cast<double>(stats.perfCounters[PERF_REDUCE].nanos));
+            }
+            printResult("reduce_dispatch", {{"threads", std::to_string(threads)},
+                                            {"streaming", streaming ? "true" : "false"}},
+                        GROUPS, nanos);
+        }
+    }
+    for (IntKey* key : keys) {
+        delete key;
+    }
+    freeBenchInput(input);
+    return 0;
+}
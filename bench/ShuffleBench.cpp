@@ -0,0 +1,52 @@
+/**
+ * Measures the cost of the shuffle per intermediate pair, for different numbers of workers (whose
+ * sorted vectors thread 0 merges) and ratios of distinct keys to pairs (which set the group sizes).
+ */
+#include "BenchUtil.h"
+
+#define SHUFFLE_PAIRS (1 << 19)
+
+/**
+ * A client which emits a single pair per input pair, cycling through a number of distinct keys.
+ */
+class CyclingClient final : public BenchClient {
+public:
+    explicit CyclingClient(const std::vector<IntKey*>& keys) : keys(keys) {}
+
+    void map(const K1*, const V1* value, void* context) const override {
+        emit2(keys[static_cast<const IndexValue*>(value)->index % keys.size()], nullptr, context);
+    }
+
+private:
+    const std::vector<IntKey*>& keys;
+};
+
+int main() {
+    InputVec input = makeBenchInput(SHUFFLE_PAIRS);
+    for (const double distinctRatio : {0.001, 0.01, 0.1, 1.0}) {
+        std::vector<IntKey*> keys;
+        const int distinct = std::max(1, static_cast<int>(SHUFFLE_PAIRS * distinctRatio));
+        for (int i = 0; i < distinct; ++i) {
+            keys.push_back(new IntKey(i));
+        }
+        const CyclingClient client(keys);
+        for (const int threads : {1, 2, 4, 8}) {
+            JobConfig config;
+            config.multiThreadLevel = threads;
+            std::vector<double> nanos;
+            for (int run = 0; run < BENCH_RUNS; ++run) {
+                JobStats stats;
+                runMeasuredJob(client, input, config, stats);
+                nanos.push_back(static_cast<double>(stats.perfCounters[PERF_SHUFFLE].nanos));
+            }
+            printResult("shuffle", {{"threads", std::to_string(threads)},
+                                    {"distinct_ratio", std::to_string(distinctRatio)}},
+                        SHUFFLE_PAIRS, nanos);
+        }
+        for (IntKey* key : keys) {
+            delete key;
+        }
+    }
+    freeBenchInput(input);
+    return 0;
+}
@@ -0,0 +1,75 @@
+/**
+ * Measures the cost of sorting the intermediate pairs of a worker, per pair, for keys of
+ * different comparison costs: integers, short strings, and long strings with a common prefix.
+ */
+#include "BenchUtil.h"
+#include <random>
+
+#define SORT_PAIRS (1 << 20)
+#define DISTINCT_KEYS (1 << 16)
+#define LONG_PREFIX 56 // Characters shared by all the long string keys before they differ
+
+/**
+ * A client which emits a fixed sequence of keys, one per input pair.
+ */
+class SequenceClient final : public BenchClient {
+public:
+    explicit SequenceClient(std::vector<K2*> sequence) : sequence(std::move(sequence)) {}
+
+    void map(const K1*, const V1* value, void* context) const override {
+        emit2(sequence[static_cast<const IndexValue*>(value)->index], nullptr, context);
+    }
+
+private:
+    const std::vector<K2*> sequence;
+};
+
+/**
+ * Runs the benchmark for a single key type.
+ * @param keyType The name of the key type.
+ * @param keys The distinct keys.
+ * @param input The input pairs.
+ */
+static void benchKeys(const char* keyType, const std::vector<K2*>& keys, const InputVec& input) {
+    std::mt19937 random(SORT_PAIRS); // The same shuffled sequence for every key type and version
+    std::vector<K2*> sequence;
+    sequence.reserve(SORT_PAIRS);
+    for (int i = 0; i < SORT_PAIRS; ++i) {
+        sequence.push_back(keys[random() % keys.size()]);
+    }
+    const SequenceClient client(std::move(sequence));
+    JobConfig config;
+    config.multiThreadLevel = 1;
+    std::vector<double> nanos;
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        JobStats stats;
+        runMeasuredJob(client, input, config, stats);
+        nanos.push_back(static_cast<double>(stats.perfCounters[PERF_SORT].nanos));
+    }
+    printResult("sort", {{"key_type", quoted(keyType)}, {"distinct_keys", std::to_string(keys.size())}},
+                SORT_PAIRS, nanos);
+}
+
+int main() {
+    InputVec input = makeBenchInput(SORT_PAIRS);
+    std::vector<K2*> intKeys;
+    std::vector<K2*> shortKeys;
+    std::vector<K2*> longKeys;
+    for (int i = 0; i < DISTINCT_KEYS; ++i) {
+        char suffix[16];
+        std::snprintf(suffix, sizeof(suffix), "%08d", i);
+        intKeys.push_back(new IntKey(i));
+        shortKeys.push_back(new StringKey(suffix));
+        longKeys.push_back(new StringKey(std::string(LONG_PREFIX, 'k') + suffix));
+    }
+    benchKeys("int", intKeys, input);
+    benchKeys("short_string", shortKeys, input);
+    benchKeys("long_string", longKeys, input);
+    for (const auto* keys : {&intKeys, &shortKeys, &longKeys}) {
+        for (K2* key : *keys) {
+            delete key;
+        }
+    }
+    freeBenchInput(input);
+    return 0;
+}
@@ -32,6 +32,10 @@ public:
 		return c < dynamic_cast<const KChar&>(other).c;
 	}
 
+	int compare(const K2 &other) const override {
+		return c - dynamic_cast<const KChar&>(other).c;
+	}
+
 	bool operator<(const K3 &other) const override {
 		return c < dynamic_cast<const KChar&>(other).c;
 	}
@@ -91,6 +95,12 @@ public:
 		// Emit the final key-value pair
 		emit3(k3, v3, context);
 	}
+
+	void releaseIntermediate(K2* key, V2* value) const override {
+		// The pairs are owned by the client, so the ones the framework did not reduce are deleted here
+		delete key;
+		delete value;
+	}
 };
 
 int main(int argc, char** argv)
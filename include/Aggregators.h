@@ -0,0 +1,102 @@
+#ifndef AGGREGATORS_H
+#define AGGREGATORS_H
+
+#include <cstdint>
+#include "MapReduceClient.h"
+
+/**
+ * The built-in aggregations that the framework can run without calling reduce.
+ */
+enum aggregate_t {AGGREGATE_SUM=0, AGGREGATE_COUNT=1, AGGREGATE_MIN=2, AGGREGATE_MAX=3, AGGREGATE_AVG=4};
+
+/**
+ * An intermediate value holding a single number.
+ * Clients of an AggregatingClient must emit their values as NumericValue instances,
+ * so the framework can read them without a dynamic_cast.
+ */
+class NumericValue final : public V2 {
+public:
+    explicit NumericValue(const double value) : value(value) {}
+
+    double value;
+};
+
+/**
+ * A running aggregate of the values of a single group.
+ * Keeps enough information to produce any of the built-in aggregations.
+ */
+class Aggregate {
+public:
+    /**
+     * Constructor for Aggregate.
+     * Creates an empty aggregate (no values were added).
+     */
+    Aggregate();
+
+    /**
+     * Adds a single value to the aggregate.
+     * @param value The value to add.
+     */
+    void add(double value);
+
+    /**
+     * Computes the requested aggregation over all the values added so far.
+     * @param kind The aggregation to compute.
+     * @return The aggregated value. 0 if no values were added.
+     */
+    [[nodiscard]] double result(aggregate_t kind) const;
+
+    /**
+     * @return The number of values added to the aggregate.
+     */
+    [[nodiscard]] uint64_t count() const;
+
+private:
+    double sum;  // Sum of all the values
+    double min;  // Smallest value
+    double max;  // Largest value
+    uint64_t numValues;  // Number of values added
+};
+
+/**
+ * A client whose reduce is one of the built-in aggregations.
+ *
+ * When the framework runs an AggregatingClient, it folds every group into an Aggregate while
+ * merging the intermediate vectors (in the shuffle phase, or in the fused phase of the streaming
+ * mode), so the groups are never stored and reduce is never called. Every consumed pair is
+ * handed to releaseIntermediate, except the key of each group, whose ownership passes to
+ * emitAggregate.
+ */
+class AggregatingClient : public MapReduceClient {
+public:
+    /**
+     * @return The aggregation to apply to the values of every group.
+     */
+    [[nodiscard]] virtual aggregate_t aggregate() const = 0;
+
+    /**
+     * Gets a group's key and its aggregated value,
+     * and calls emit3(K3, V3, context) to output the (K3, V3) pair.
+     * @param key The key of the group. The client takes ownership of it.
+     * @param result The aggregated value of the group.
+     * @param context The context to pass to emit3.
+     */
+    virtual void emitAggregate(K2* key, double result, void* context) const = 0;
+
+    /**
+     * Releases a pair the framework folded into an aggregate (see MapReduceClient).
+     * Unlike a plain client, an aggregating client must implement it, since every pair it emits
+     * is consumed by the framework.
+     */
+    void releaseIntermediate(K2* key, V2* value) const override = 0;
+
+    /**
+     * Aggregates the pairs of a single group the same way the framework folds them, releasing
+     * every pair but the group's key, which is passed to emitAggregate.
+     * The framework folds the groups itself, in the shuffle phase or straight from the merge in
+     * the streaming mode, and never calls it. It is only used if reduce is called directly.
+     */
+    void reduce(const IntermediateVec* pairs, void* context) const override;
+};
+
+#endif //AGGREGATORS_H
@@ -0,0 +1,126 @@
+#ifndef ASYNCMAP_H
+#define ASYNCMAP_H
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <utility>
+#include "MapReduceClient.h"
+
+/**
+ * The coroutine type returned by AsyncMapReduceClient::mapAsync.
+ * The task does not start until the framework resumes it.
+ */
+class MapTask {
+public:
+    struct promise_type {
+        std::exception_ptr exception;  // The exception the task ended with, if any
+        uint32_t inputIndex = 0;  // The index of the task's input pair, set by the framework
+
+        MapTask get_return_object() {
+            return MapTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { exception = std::current_exception(); }
+    };
+
+    explicit MapTask(const std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    MapTask(MapTask&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+    MapTask& operator=(MapTask&& other) noexcept {
+        if (this != &other) {
+            if (handle) {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+
+    MapTask(const MapTask&) = delete;
+    MapTask& operator=(const MapTask&) = delete;
+
+    ~MapTask() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    /**
+     * Gives up the ownership of the coroutine, which must then be destroyed by the caller.
+     * @return The handle of the coroutine.
+     */
+    std::coroutine_handle<promise_type> release() noexcept {
+        return std::exchange(handle, nullptr);
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+/**
+ * An awaitable that runs a blocking call (a lookup, a file read) without blocking the worker.
+ *
+ * When awaited from mapAsync, the task is suspended and the call is run by one of the job's I/O
+ * threads, while the worker goes on mapping other input pairs. Once the call returns, the task
+ * is resumed by the same worker, so emit2 may be called as usual. If the context cannot suspend
+ * (e.g. mapAsync is driven by map), the call is simply run in place.
+ * An exception thrown by the call is rethrown from the co_await.
+ *
+ * Usage: co_await BlockingCall([&] { record = store.get(key); }, context);
+ */
+class BlockingCall {
+public:
+    BlockingCall(std::function<void()> call, void* context)
+        : call(std::move(call)), context(context) {}
+
+    bool await_ready();
+
+    void await_suspend(std::coroutine_handle<> handle);
+
+    void await_resume() const {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+
+private:
+    std::function<void()> call;  // The blocking call
+    void* context;  // The context passed from the framework to mapAsync
+    std::exception_ptr exception;  // The exception thrown by the call, if any
+};
+
+/**
+ * A client whose map may wait for I/O without tying up a worker thread.
+ *
+ * The framework keeps up to JobConfig::asyncTasksPerWorker map tasks in flight on every worker:
+ * whenever a task awaits a BlockingCall, the worker starts or resumes another one.
+ */
+class AsyncMapReduceClient : public MapReduceClient {
+public:
+    /**
+     * Gets a single pair (K1, V1), and calls emit2(K2,V2, context) any number of times to output
+     * (K2, V2) pairs. May co_await BlockingCall any number of times.
+     */
+    virtual MapTask mapAsync(const K1* key, const V1* value, void* context) const = 0;
+
+    /**
+     * Runs mapAsync to completion on the calling thread, running its blocking calls in place.
+     * The framework never calls it, but it lets an async client be used like any other.
+     */
+    void map(const K1* key, const V1* value, void* context) const override {
+        auto handle = mapAsync(key, value, context).release();
+        handle.resume(); // Every BlockingCall completes in place, so one resume runs the whole task
+        const std::exception_ptr exception = handle.promise().exception;
+        handle.destroy();
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+#endif //ASYNCMAP_H
@@ -1,6 +1,8 @@
 #ifndef BARRIER_H
 #define BARRIER_H
 
+#include <atomic>
+#include <cstdint>
 #include <mutex>
 #include <condition_variable>
 
@@ -33,6 +35,21 @@ public:
      */
     void barrier();
 
+    /**
+     * @return The number of times a thread blocked at the barrier, waiting for the others.
+     */
+    [[nodiscard]] uint64_t waits() const;
+
+    /**
+     * @return The total time threads spent blocked at the barrier, in nanoseconds.
+     */
+    [[nodiscard]] uint64_t waitNanos() const;
+
+    /**
+     * @brief Resets waits() and waitNanos() to 0. Must not be called while threads are at the barrier.
+     */
+    void resetWaits();
+
     ~Barrier() = default;
 
 private:
@@ -41,6 +58,8 @@ private:
     int count;  // Number of threads that have reached the barrier
     int generation;  // Generation number to track the state of the barrier
     const int numThreads;  // Total number of threads that need to reach the barrier
+    std::atomic<uint64_t> waitCount;  // Times a thread blocked at the barrier
+    std::atomic<uint64_t> waitTime;  // Nanoseconds threads spent blocked at the barrier
 };
 
 #endif // BARRIER_H
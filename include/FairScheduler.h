@@ -0,0 +1,90 @@
+#ifndef FAIRSCHEDULER_H
+#define FAIRSCHEDULER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+/**
+ * @class FairScheduler
+ * @brief Shares a fixed number of execution slots between the jobs running on a host.
+ *
+ * The workers of every job hold a slot while they run a batch of tasks (map calls, reduce groups),
+ * so no more than slots() batches run at once, whatever the jobs' thread counts are.
+ * A free slot goes to the waiting job with the highest priority. Between jobs of the same
+ * priority, slots are given by stride scheduling, so every job gets a share of the batches
+ * proportional to its weight.
+ */
+class FairScheduler {
+public:
+    /**
+     * @brief Constructs a FairScheduler.
+     * @param slots The number of batches that may run at once, usually the number of cores.
+     */
+    explicit FairScheduler(int slots);
+
+    FairScheduler(const FairScheduler&) = delete;
+    FairScheduler& operator=(const FairScheduler&) = delete;
+
+    /**
+     * @brief Registers a job with the scheduler.
+     * @param priority The priority of the job. Jobs of a higher priority always get slots first,
+     *                 so latency-sensitive jobs are never held back by background jobs.
+     * @param weight The share of the job between the jobs of its priority. Must be positive.
+     * @return An identifier of the job, to be passed to the other functions.
+     */
+    int addJob(int priority, int weight);
+
+    /**
+     * @brief Unregisters a job which holds no slot and waits for none.
+     * @param job The identifier returned by addJob.
+     */
+    void removeJob(int job);
+
+    /**
+     * @brief Blocks until the job is given a slot.
+     * @param job The identifier returned by addJob.
+     */
+    void acquire(int job);
+
+    /**
+     * @brief Returns a slot taken by acquire, passing it to the next waiting job.
+     * @param job The identifier returned by addJob.
+     */
+    void release(int job);
+
+    /**
+     * @return The number of batches that may run at once.
+     */
+    [[nodiscard]] int slots() const;
+
+private:
+    /**
+     * The scheduling state of a single job.
+     */
+    struct Share {
+        int priority;  // Jobs of a higher priority are served first
+        uint64_t stride;  // How far the pass advances per slot, inversely proportional to the weight
+        uint64_t pass;  // The job's virtual time. The job with the lowest pass is served next
+        int waiting;  // Workers of the job waiting for a slot
+        int running;  // Slots held by the job
+    };
+
+    /**
+     * @brief Checks whether the given job is the next one to get a slot. Must be called under mutex.
+     * @param job The identifier of a waiting job.
+     * @return true if no waiting job comes before it.
+     */
+    bool isNext(int job) const;
+
+    std::mutex mutex;  // Mutex for the shares and the counters
+    std::condition_variable cv;  // Signalled when a slot is freed or the next job changes
+    const int totalSlots;  // Batches that may run at once
+    int freeSlots;  // Slots not held by any job
+    uint64_t virtualTime;  // The pass of the job that was last given a slot
+    int nextJobId;  // The identifier of the next registered job
+    std::unordered_map<int, Share> shares;  // The registered jobs
+};
+
+#endif //FAIRSCHEDULER_H
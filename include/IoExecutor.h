@@ -0,0 +1,52 @@
+#ifndef IOEXECUTOR_H
+#define IOEXECUTOR_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class IoExecutor
+ * @brief A small pool of threads that run blocking calls (I/O) on behalf of the map workers.
+ *
+ * The calls are run in submission order by whichever thread is free.
+ */
+class IoExecutor {
+public:
+    /**
+     * @brief Constructs an IoExecutor and starts its threads.
+     * @param numThreads The number of threads running the blocking calls.
+     */
+    explicit IoExecutor(int numThreads);
+
+    /**
+     * @brief Runs all the calls that were already submitted, then stops the threads.
+     */
+    ~IoExecutor();
+
+    IoExecutor(const IoExecutor&) = delete;
+    IoExecutor& operator=(const IoExecutor&) = delete;
+
+    /**
+     * @brief Queues a call to be run by one of the threads.
+     * @param call The call to run. It must not throw.
+     */
+    void submit(std::function<void()> call);
+
+private:
+    /**
+     * @brief The function of every thread: runs queued calls until the executor is stopped.
+     */
+    void run();
+
+    std::mutex mutex;  // Mutex for the queue and the stop flag
+    std::condition_variable cv;  // Signalled when a call is queued or the executor is stopped
+    std::deque<std::function<void()>> calls;  // Calls waiting for a free thread
+    bool stopping;  // Set when the executor is destroyed
+    std::vector<std::thread> threads;  // The threads running the calls
+};
+
+#endif //IOEXECUTOR_H
@@ -0,0 +1,62 @@
+#ifndef ITERATIVEJOB_H
+#define ITERATIVEJOB_H
+
+#include "MapReduceFramework.h"
+
+#define ITERATIVE_JOB_FAILED (-1)
+
+/**
+ * A client for algorithms that run the same map and reduce repeatedly (e.g. k-means, PageRank),
+ * feeding the output of every iteration back as the input of the next one.
+ */
+class IterativeClient : public MapReduceClient {
+public:
+    /**
+     * Gets the value that map and reduce can read through getBroadcast during the given iteration,
+     * e.g. the current centroids. The value is shared by all the workers without being copied,
+     * so it must stay alive and unchanged until the iteration is finished.
+     * @param iteration The index of the iteration that is about to start.
+     * @return The value to share, or nullptr.
+     */
+    virtual const void* broadcast(int iteration) const {
+        (void) iteration;
+        return nullptr;
+    }
+
+    /**
+     * Checks whether the algorithm converged after the given iteration.
+     * @param iteration The index of the iteration that just finished.
+     * @param output The output of the iteration.
+     * @return true to stop iterating, keeping output as the final output, false to go on.
+     */
+    virtual bool converged(int iteration, const OutputVec& output) const = 0;
+
+    /**
+     * Builds the input of the next iteration from the output of the current one.
+     * The client owns the elements of both vectors, so it should release whatever it no longer needs.
+     * @param output The output of the iteration that just finished. Cleared by the framework afterwards.
+     * @param input The input of the iteration that just finished, to be replaced in place by the
+     *              input of the next iteration.
+     */
+    virtual void feedback(OutputVec& output, InputVec& input) const = 0;
+};
+
+/**
+ * This function runs a job iteratively until the client reports convergence.
+ * All the iterations run on a single reusable job, so steady-state iterations perform no
+ * large allocations and no per-iteration setup besides starting the worker threads.
+ * @param client The implementation of IterativeClient.
+ * @param input The input of the first iteration. Replaced by the input of every next iteration.
+ * @param output A vector to which the output of the last iteration will be added.
+ *               We assume that it is empty.
+ * @param config The configuration of the job, used for all the iterations.
+ * @param maxIterations The maximal number of iterations to run.
+ * @return The number of iterations that were run, or ITERATIVE_JOB_FAILED if an iteration failed:
+ *         it exceeded its memory budget, or the client threw from one of its calls. The iteration's
+ *         partial output is then left in output for the client to release, without calling
+ *         converged or feedback on it, and the error is not reported any further.
+ */
+int runIterativeJob(const IterativeClient& client, InputVec& input, OutputVec& output,
+                    const JobConfig& config, int maxIterations);
+
+#endif //ITERATIVEJOB_H
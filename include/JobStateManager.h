@@ -2,6 +2,7 @@
 #ifndef JOBSTATEMANAGER_H
 #define JOBSTATEMANAGER_H
 
+#include <array>
 #include <atomic>
 #include "MapReduceFramework.h"
 
@@ -32,8 +33,9 @@ public:
 
     /**
      * Thread-safe increment of the processed count.
+     * @param amount The number of newly processed elements.
      */
-    void incrementProcessed();
+    void incrementProcessed(uint32_t amount = 1);
 
     /**
      * Sets the total number of elements.
@@ -50,6 +52,15 @@ public:
      */
     void setStage(stage_t newStage);
 
+    /**
+     * Sets the stage of the job, unless another thread already moved it on from a given stage.
+     * Also resets the processed count to 0 if the stage was set.
+     * @param oldStage The stage the job must still be in.
+     * @param newStage The new stage of the job.
+     * @return true if the stage was set, false if the job was not in oldStage.
+     */
+    bool advanceStage(stage_t oldStage, stage_t newStage);
+
     /**
      * Retrieves the current state of the job.
      * @param outStage Where to store the current stage of the job.
@@ -58,8 +69,33 @@ public:
      */
     void getState(stage_t &outStage, uint32_t &outProcessed, uint32_t &outTotal) const;
 
+    /**
+     * Retrieves the number of elements processed in a stage of the current run.
+     * Moving to UNDEFINED_STAGE starts a new run, resetting the counts of all the stages.
+     * @param stage The stage.
+     * @return The processed count if it is the current stage, or the count the stage ended with.
+     */
+    uint32_t getProcessed(stage_t stage) const;
+
+    /**
+     * Retrieves the time a stage of the current run started at. UNDEFINED_STAGE starts with the run.
+     * @param stage The stage.
+     * @return The steady_clock time in nanoseconds, or 0 if the stage has not started yet.
+     */
+    int64_t getStageStart(stage_t stage) const;
+
 private:
     std::atomic<uint64_t> state;  // [63..62]=stage | [61..31]=processed | [30..0]=total
+    std::array<std::atomic<uint32_t>, 4> finalProcessed;  // The count every past stage ended with
+    std::array<std::atomic<int64_t>, 4> stageStarts;  // The time every stage started at, or 0
+
+    /**
+     * Keeps the processed count of the current stage before the job moves to another stage,
+     * and the time the new stage starts at.
+     * @param oldVal The packed state the job moves from.
+     * @param newStage The stage the job moves to.
+     */
+    void recordTransition(uint64_t oldVal, stage_t newStage);
 
     /**
      * Encodes the state of the job into a packed 64-bit integer.
@@ -0,0 +1,213 @@
+#ifndef LATENCYPROFILE_H
+#define LATENCYPROFILE_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "MapReduceFramework.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define HISTOGRAM_SUB_BUCKET_BITS 4 // Linear sub-buckets per power of 2, for a relative error of 1/16
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS (64 * HISTOGRAM_SUB_BUCKETS)
+
+/**
+ * Reads a cheap, monotonic tick counter: the time-stamp counter on x86, the virtual counter on
+ * AArch64, and steady_clock nanoseconds elsewhere.
+ * @return The current tick count.
+ */
+inline uint64_t readTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+/**
+ * Converts a number of ticks of readTicks to nanoseconds. The rate is calibrated against
+ * steady_clock on the first call, which takes about a millisecond.
+ * @param ticks A difference between two readTicks values.
+ * @return The number of nanoseconds.
+ */
+uint64_t ticksToNanos(uint64_t ticks);
+
+/**
+ * @class LatencyHistogram
+ * @brief A histogram of durations with a bounded relative error, in the style of HdrHistogram.
+ *
+ * Every power of 2 is split into HISTOGRAM_SUB_BUCKETS linear buckets, so any value from a
+ * nanosecond up to centuries is kept within 1/16 of its magnitude, in a fixed amount of memory.
+ * Not thread-safe: every worker records into its own histogram, and they are merged afterwards.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    /**
+     * @brief Records a single duration.
+     * @param nanos The duration in nanoseconds.
+     */
+    void record(uint64_t nanos);
+
+    /**
+     * @brief Adds all the durations recorded by another histogram.
+     * @param other The histogram to add.
+     */
+    void merge(const LatencyHistogram& other);
+
+    /**
+     * @brief Removes all the recorded durations.
+     */
+    void clear();
+
+    /**
+     * @return The number of recorded durations.
+     */
+    [[nodiscard]] uint64_t count() const;
+
+    /**
+     * @return The shortest recorded duration in nanoseconds, or 0 if none was recorded.
+     */
+    [[nodiscard]] uint64_t min() const;
+
+    /**
+     * @return The longest recorded duration in nanoseconds.
+     */
+    [[nodiscard]] uint64_t max() const;
+
+    /**
+     * @return The mean of the recorded durations in nanoseconds, or 0 if none was recorded.
+     */
+    [[nodiscard]] double mean() const;
+
+    /**
+     * @brief Gets a percentile of the recorded durations.
+     * @param percentile The percentile, between 0 and 100.
+     * @return The upper bound of the bucket holding the percentile, in nanoseconds
+     *         (never above max()), or 0 if no duration was recorded.
+     */
+    [[nodiscard]] uint64_t percentile(double percentile) const;
+
+private:
+    /**
+     * @brief Finds the bucket of a value.
+     * @param value The value.
+     * @return The index of the bucket.
+     */
+    static size_t bucketOf(uint64_t value);
+
+    /**
+     * @brief Finds the largest value of a bucket.
+     * @param bucket The index of the bucket.
+     * @return The largest value that falls in the bucket.
+     */
+    static uint64_t bucketUpperBound(size_t bucket);
+
+    std::array<uint64_t, HISTOGRAM_BUCKETS> counts;  // Recorded durations per bucket
+    uint64_t total;  // Number of recorded durations
+    uint64_t sum;  // Sum of recorded durations
+    uint64_t minValue;  // Shortest recorded duration
+    uint64_t maxValue;  // Longest recorded duration
+};
+
+/**
+ * A single slow call of the client's map or reduce.
+ *
+ * stage_t stage: MAP_STAGE for a map call, REDUCE_STAGE for a reduce call.
+ *
+ * size_t index: The index of the input pair for a map call. For a reduce call, the index of the
+ *               group in the shuffled data, or of the key range in streaming mode.
+ *
+ * uint64_t nanos: The duration of the call.
+ */
+typedef struct {
+    stage_t stage;
+    size_t index;
+    uint64_t nanos;
+} SlowTask;
+
+/**
+ * @class TaskProfile
+ * @brief The latency histograms of a job's map and reduce calls, and its slowest calls.
+ *
+ * Not thread-safe: every worker records into its own profile, and they are merged afterwards.
+ */
+class TaskProfile {
+public:
+    /**
+     * @brief Constructs an empty profile.
+     * @param maxSlowest The number of slowest calls to keep.
+     */
+    explicit TaskProfile(size_t maxSlowest = 0);
+
+    /**
+     * @brief Records a single call.
+     * @param stage MAP_STAGE or REDUCE_STAGE.
+     * @param index The index of the call's input pair, group or key range (see SlowTask).
+     * @param nanos The duration of the call.
+     */
+    void record(stage_t stage, size_t index, uint64_t nanos);
+
+    /**
+     * @brief Adds all the calls recorded by another profile, keeping the slowest ones of both.
+     * @param other The profile to add.
+     */
+    void merge(const TaskProfile& other);
+
+    /**
+     * @brief Removes all the recorded calls.
+     */
+    void clear();
+
+    /**
+     * @return The histogram of the map calls.
+     */
+    [[nodiscard]] const LatencyHistogram& mapLatency() const;
+
+    /**
+     * @return The histogram of the reduce calls.
+     */
+    [[nodiscard]] const LatencyHistogram& reduceLatency() const;
+
+    /**
+     * @return The number of slowest calls the profile keeps.
+     */
+    [[nodiscard]] size_t maxSlowestTasks() const;
+
+    /**
+     * @return The slowest recorded calls, slowest first.
+     */
+    [[nodiscard]] std::vector<SlowTask> slowest() const;
+
+private:
+    /**
+     * @brief Offers a call to the slowest calls, replacing the fastest of them if they are full.
+     * @param task The call.
+     */
+    void offer(const SlowTask& task);
+
+    LatencyHistogram mapHistogram;  // Durations of the map calls
+    LatencyHistogram reduceHistogram;  // Durations of the reduce calls
+    size_t maxSlowest;  // Number of slowest calls to keep
+    std::vector<SlowTask> slowestHeap;  // The slowest calls, as a min-heap on the duration
+};
+
+/**
+ * This function gets the latency profile of a job (see JobConfig::profileTasks).
+ * Should be called once the job is done, e.g. after waitForJob.
+ * @param job The JobHandle of the job.
+ * @param profile Set to the merged profile of all the job's workers.
+ */
+void getTaskProfile(JobHandle job, TaskProfile& profile);
+
+#endif //LATENCYPROFILE_H
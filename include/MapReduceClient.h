@@ -1,6 +1,8 @@
 #ifndef MAPREDUCECLIENT_H
 #define MAPREDUCECLIENT_H
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <utility>
 
@@ -43,6 +45,23 @@ public:
 	 * @return true if this key is less than the other key, false otherwise.
 	 */
 	virtual bool operator<(const K2 &other) const = 0;
+
+	/**
+	 * Compares this key with another key in a single call.
+	 * The framework uses it to test keys for equality while grouping the intermediate pairs,
+	 * and operator< wherever only their order matters. The default implementation calls
+	 * operator< up to twice, so overriding it with a single comparison halves the cost of grouping.
+	 *
+	 * @param other The other key to compare with this key.
+	 * @return A negative value if this key is less than the other key, a positive value if it is
+	 *         greater, and 0 if the keys are equal.
+	 */
+	virtual int compare(const K2 &other) const {
+		if (*this < other) {
+			return -1;
+		}
+		return other < *this ? 1 : 0;
+	}
 };
 
 class V2 {
@@ -98,11 +117,54 @@ public:
 	 */
 	virtual void map(const K1* key, const V1* value, void* context) const = 0;
 
+	/**
+	 * An optional hint of the average number of pairs map emits for a single input pair.
+	 * The framework reserves the intermediate vectors accordingly, so they do not have to grow
+	 * (and be copied) while mapping. If it returns 0, the framework estimates the fan-out from
+	 * the first map calls of every thread instead.
+	 */
+	virtual double expectedEmitsPerInput() const {
+		return 0;
+	}
+
+	/**
+	 * An optional hint of the memory owned by a single emitted (K2, V2) pair, e.g. the sizes of
+	 * the key and value objects. The framework adds it to the job's memory accounting.
+	 */
+	virtual size_t intermediatePairBytes() const {
+		return 0;
+	}
+
 	/**
 	 * Gets a single K2 key and a vector of all its respective V2 values,
 	 * and calls emit3(K3, V3, context) any number of times (usually once) to output (K3, V3) pairs.
 	 */
 	virtual void reduce(const IntermediateVec* pairs, void* context) const = 0;
+
+	/**
+	 * Releases an intermediate pair that the framework consumed on the client's behalf instead of
+	 * handing it to reduce: a pair folded by a built-in aggregator, a pair left over when a job
+	 * fails or is aborted, or the output of a discarded map call (see JobConfig).
+	 * Either pointer may be nullptr.
+	 * The default implementation does nothing, since the framework cannot tell whether the client
+	 * shares its K2/V2 objects. A client that owns its intermediate pairs should delete them here,
+	 * or they leak on those paths.
+	 */
+	virtual void releaseIntermediate(K2* key, V2* value) const {
+		(void) key;
+		(void) value;
+	}
+
+	/**
+	 * An optional digest of the content of a single output pair, which lets a deterministic job
+	 * verify that two runs produced identical output (see JobStats::outputDigest).
+	 * The default returns 0, so only the number of output pairs is compared.
+	 */
+	virtual uint64_t outputDigest(const K3* key, const V3* value) const {
+		(void) key;
+		(void) value;
+		return 0;
+	}
 };
 
 
@@ -1,9 +1,28 @@
 #ifndef MAPREDUCEFRAMEWORK_H
 #define MAPREDUCEFRAMEWORK_H
 
+#include <cstddef>
+#include <cstdint>
+#include <exception>
 #include "MapReduceClient.h"
 
 #define MAX_PERCENTAGE 100.0f
+#define DEFAULT_MEMORY_WAIT_MS 100
+#define DEFAULT_ASYNC_TASKS_PER_WORKER 16
+#define DEFAULT_ASYNC_IO_THREADS 4
+#define NO_TASK_INDEX (-1)
+#define DEFAULT_SLOWEST_TASKS 10
+#define PERF_EVENTS 4
+#define PERF_EVENT_CYCLES 1u
+#define PERF_EVENT_INSTRUCTIONS 2u
+#define PERF_EVENT_CACHE_MISSES 4u
+#define PERF_EVENT_BRANCH_MISSES 8u
+#define PERF_ALL_EVENTS 15u
+
+class MemoryBudget;
+class FairScheduler;
+class TaskProfile;
+class MetricsRegistry;
 
 /**
  * An identifier of a running job.
@@ -28,6 +47,263 @@ typedef struct {
 	float percentage;
 } JobState;
 
+/**
+ * A struct which estimates the progress of a whole run of a job (see getJobProgress).
+ *
+ * stage_t stage: The current stage of the job.
+ *
+ * float stagePercentage: The percentage of the current stage that has been completed, as in JobState.
+ *
+ * float overallPercentage: The percentage of the whole run that has been completed. Every stage is
+ *                          weighted by its expected duration: the stages that ended by their
+ *                          measured duration, the current stage by extrapolating its throughput,
+ *                          and the next stages relative to the map, as measured in the job's
+ *                          previous run (or by default ratios in its first run).
+ *
+ * double throughput: The elements processed per second in the current stage (see JobMetrics::processed).
+ *
+ * double elapsedSeconds: The time since the run started.
+ *
+ * double etaSeconds: The estimated time left until the run is done, or -1 until the first input
+ *                    pair has been mapped.
+ */
+typedef struct {
+	stage_t stage;
+	float stagePercentage;
+	float overallPercentage;
+	double throughput;
+	double elapsedSeconds;
+	double etaSeconds;
+} JobProgress;
+
+/**
+ * The phases of a worker measured by the hardware performance counters (see JobConfig::perfCounters).
+ * PERF_SORT is the sorting of the worker's intermediate data after the map, and PERF_SHUFFLE is
+ * only run by thread 0.
+ */
+enum perf_phase_t {PERF_MAP=0, PERF_SORT=1, PERF_SHUFFLE=2, PERF_REDUCE=3, PERF_PHASES=4};
+
+/**
+ * The hardware performance counts of one or more workers in a single phase, in user space only.
+ * An event which could not be counted (see JobStats::perfEvents) is left at 0, but the wall time
+ * of the phase (nanos) is always measured.
+ */
+typedef struct {
+	uint64_t nanos;
+	uint64_t cycles;
+	uint64_t instructions;
+	uint64_t cacheMisses;
+	uint64_t branchMisses;
+} PhaseCounters;
+
+/**
+ * A struct which describes the first error of a failed job.
+ *
+ * stage_t stage: The stage in which the error occurred, or UNDEFINED_STAGE if the job's threads
+ *                could not be created.
+ *
+ * long taskIndex: The task that was running when the error occurred: the index of the input pair in
+ *                 the map stage, of the group in the reduce stage, or of the key range in streaming
+ *                 mode. NO_TASK_INDEX if the error did not occur in a task (e.g. in the shuffle).
+ *
+ * std::exception_ptr exception: The exception that was thrown.
+ */
+typedef struct {
+	stage_t stage;
+	long taskIndex;
+	std::exception_ptr exception;
+} JobError;
+
+/**
+ * A struct which configures how a job runs.
+ *
+ * int multiThreadLevel: The number of worker threads to be used for running the algorithm.
+ *                       We assume that it is greater-than or equal-to 1.
+ *
+ * bool streamingReduce: If true, the shuffle and reduce phases are fused. The sorted intermediate
+ *                       vectors are split into key ranges, and each worker merges the ranges it
+ *                       claims and streams every group directly into reduce, so the grouped vectors
+ *                       are never stored. In this mode the reduce stage's percentage counts
+ *                       intermediate pairs instead of groups.
+ *
+ * bool outputQueue: If true, emit3 appends to a per-thread chunk instead of locking the output
+ *                   vector, and every full chunk is linked to a lock-free queue. The published
+ *                   output can be taken with pollJobOutput while the job is still running, and
+ *                   whatever was not taken is added to the output vector at the end of the job.
+ *
+ * size_t memoryBudgetBytes: If non-zero, the job gets a budget of its own of this many bytes.
+ *                           The job accounts sizeof(IntermediatePair) plus the client's
+ *                           intermediatePairBytes hint for every emitted pair, and
+ *                           sizeof(OutputPair) for every output pair, as well as the intermediate
+ *                           segments reserved ahead of the emits (see expectedEmitsPerInput).
+ *                           Bytes are charged and released in steps of SEGMENT_BYTES. If an emit2
+ *                           does not fit in the budget, the job stops mapping, hands all its
+ *                           intermediate pairs to releaseIntermediate, and finishes without output,
+ *                           reporting JobStats::memoryBudgetExceeded.
+ *
+ * MemoryBudget* memoryBudget: A budget shared with other jobs, used instead of memoryBudgetBytes.
+ *
+ * int memoryWaitMs: How long a map worker waits for room in the budget before the job fails.
+ *                   This back-pressure lets the jobs sharing a budget finish and release their
+ *                   memory, instead of failing the moment the budget fills up. Not used with
+ *                   memoryBudgetBytes, since only the job itself could make room in its own budget.
+ *
+ * int asyncTasksPerWorker: For an AsyncMapReduceClient, the most map tasks a worker keeps in flight.
+ *                          While some of them wait for blocking calls, the worker runs the others.
+ *
+ * int asyncIoThreads: For an AsyncMapReduceClient, the number of threads the job runs the blocking
+ *                     calls of its map tasks on (see BlockingCall in AsyncMap.h).
+ *
+ * FairScheduler* scheduler: A scheduler shared with other jobs, or nullptr. If set, the workers run
+ *                           their tasks in batches, and hold one of the scheduler's slots per batch.
+ *
+ * int priority: The priority of the job in the scheduler. Jobs of a higher priority get slots first.
+ *
+ * int weight: The share of the job in the scheduler, relative to the other jobs of its priority.
+ *
+ * bool adaptiveThreads: If true, multiThreadLevel is only the maximal number of workers. The map and
+ *                       reduce phases start with a few active workers, and the framework keeps
+ *                       adding workers while its measured throughput grows, going back to the best
+ *                       level once adding workers stops helping (e.g. when map is memory-bound).
+ *                       The chosen levels are reported in JobStats.
+ *
+ * bool speculativeMap: If true, the emits of every map call are staged until the call returns.
+ *                      Workers that ran out of input pairs run a duplicate of any map call that has
+ *                      been running far longer than the median one, and the output of the call
+ *                      that returns first is kept, while the other one's is handed to
+ *                      releaseIntermediate. The client's map must therefore be safe to run twice
+ *                      at once on the same pair. Not used for an AsyncMapReduceClient.
+ *
+ * bool catchMapExceptions: If true, the emits of every map call are staged until the call returns.
+ *                          If map throws, the pairs it already emitted are handed to
+ *                          releaseIntermediate and the call is retried, up to mapRetries times.
+ *                          A pair whose last attempt throws too is recorded as failed (see
+ *                          getFailedMapInputs), and the job goes on without its output.
+ *                          Not used for an AsyncMapReduceClient.
+ *
+ * int mapRetries: How many times a throwing map call is retried before its pair is recorded as failed.
+ *
+ * bool profileTasks: If true, every call of the client's map and reduce is timed with the CPU's
+ *                    tick counter, and the job keeps latency histograms of both and a list of its
+ *                    slowest calls (see getTaskProfile). The tasks of an AsyncMapReduceClient are
+ *                    not timed, since most of their time is spent waiting for blocking calls.
+ *
+ * int slowestTasks: How many of the slowest calls the profile keeps.
+ *
+ * bool perfCounters: If true, every worker measures the wall time of each of its phases, and counts
+ *                    CPU cycles, instructions, cache misses and branch misses in them with
+ *                    perf_event_open (Linux only). Events that cannot be opened are left out
+ *                    (see JobStats::perfEvents).
+ *
+ * MetricsRegistry* metrics: A registry exposing the job's metrics to monitoring, or nullptr.
+ *                           The job is registered until its handle is closed.
+ *
+ * const char* metricsName: The value of the job's "job" label in the registry, or nullptr to name
+ *                          it by its registration order. Copied when the job is created.
+ *
+ * bool deterministic: If true, every worker maps a fixed, contiguous share of the input pairs and
+ *                     reduces a fixed share of the groups (or key ranges), and the output vector
+ *                     is filled in the order of the groups once all the workers are done. Two runs on the same
+ *                     input then do the same work per worker and produce the same output order,
+ *                     and JobStats::outputDigest tells whether their output is identical.
+ *                     adaptiveThreads and speculativeMap are ignored, and the tasks of an
+ *                     AsyncMapReduceClient run one at a time on every worker.
+ *
+ * bool sortOutput: If true, the output pairs are sorted by key (K3::operator<) before the job is done.
+ *                  Every worker sorts its own output, and the workers then merge the sorted outputs
+ *                  in parallel, each into its own part of the output vector. Pairs with equal keys
+ *                  stay in the order of the workers, and of the emits of each worker. With outputQueue,
+ *                  the pairs are only published once the whole output is sorted. If the job fails,
+ *                  the output is written unsorted.
+ *
+ * size_t inlineInputPairs: Jobs started by startMapReduceJob with at most this many input pairs are
+ *                          run to completion by the calling thread as a single worker (see
+ *                          runMapReduceJob) before startMapReduceJob returns, since starting the
+ *                          worker threads would cost more than the job itself. 0 disables it.
+ *
+ * int mapThreadLevel: The number of workers that run the map phase, at most multiThreadLevel, or 0 for
+ *                     all of them. The other workers skip the phase and wait for the next one without
+ *                     holding a scheduler slot, so jobs sharing a FairScheduler get the cores that
+ *                     the phase does not use. With adaptiveThreads, the most workers the phase adapts up to.
+ *
+ * int reduceThreadLevel: The same as mapThreadLevel, for the reduce phase. The shuffle is always run
+ *                        by a single worker, while all the others wait without a scheduler slot.
+ */
+typedef struct {
+	int multiThreadLevel = 1;
+	bool streamingReduce = false;
+	bool outputQueue = false;
+	size_t memoryBudgetBytes = 0;
+	MemoryBudget* memoryBudget = nullptr;
+	int memoryWaitMs = DEFAULT_MEMORY_WAIT_MS;
+	int asyncTasksPerWorker = DEFAULT_ASYNC_TASKS_PER_WORKER;
+	int asyncIoThreads = DEFAULT_ASYNC_IO_THREADS;
+	FairScheduler* scheduler = nullptr;
+	int priority = 0;
+	int weight = 1;
+	bool adaptiveThreads = false;
+	bool speculativeMap = false;
+	bool catchMapExceptions = false;
+	int mapRetries = 0;
+	bool profileTasks = false;
+	int slowestTasks = DEFAULT_SLOWEST_TASKS;
+	bool perfCounters = false;
+	MetricsRegistry* metrics = nullptr;
+	const char* metricsName = nullptr;
+	bool deterministic = false;
+	bool sortOutput = false;
+	size_t inlineInputPairs = 0;
+	int mapThreadLevel = 0;
+	int reduceThreadLevel = 0;
+} JobConfig;
+
+/**
+ * A struct which holds statistics about a job.
+ *
+ * size_t memoryUsedBytes: The bytes the job currently accounts for (see JobConfig::memoryBudgetBytes).
+ *
+ * size_t memoryHighWaterBytes: The most bytes the job accounted for at once.
+ *
+ * bool memoryBudgetExceeded: Whether the job was aborted because it ran out of its memory budget.
+ *
+ * int mapThreads: The number of workers that ran the map phase (see JobConfig::adaptiveThreads).
+ *
+ * int reduceThreads: The number of workers that ran the reduce phase.
+ *
+ * size_t speculativeTasks: The number of duplicate map calls run (see JobConfig::speculativeMap).
+ *
+ * size_t speculativeWins: The number of duplicate map calls which returned first.
+ *
+ * size_t retriedMapCalls: The number of map calls that were retried after throwing
+ *                         (see JobConfig::catchMapExceptions).
+ *
+ * size_t failedMapInputs: The number of input pairs whose map failed on every attempt.
+ *
+ * unsigned perfEvents: The PERF_EVENT_* bits of the events every worker could count
+ *                      (see JobConfig::perfCounters), or 0 if none could be.
+ *
+ * PhaseCounters perfCounters[PERF_PHASES]: The counts of all the workers in every phase
+ *                                          (see getWorkerPerfCounters).
+ *
+ * uint64_t outputDigest: A digest of the output of a deterministic run, in order, made of the
+ *                        client's MapReduceClient::outputDigest of every pair, or 0 while the run
+ *                        is not done or the job is not deterministic.
+ */
+typedef struct {
+	size_t memoryUsedBytes;
+	size_t memoryHighWaterBytes;
+	bool memoryBudgetExceeded;
+	int mapThreads;
+	int reduceThreads;
+	size_t speculativeTasks;
+	size_t speculativeWins;
+	size_t retriedMapCalls;
+	size_t failedMapInputs;
+	unsigned perfEvents;
+	PhaseCounters perfCounters[PERF_PHASES];
+	uint64_t outputDigest;
+} JobStats;
+
 /**
  * This function saves the intermediary elements (K2*, V2*) in the context's data structures.
  * @param key The key of an intermediary input element.
@@ -63,6 +339,128 @@ JobHandle startMapReduceJob(const MapReduceClient& client,
 	const InputVec& inputVec, OutputVec& outputVec,
 	int multiThreadLevel);
 
+/**
+ * This function starts running the MapReduce algorithm with the given configuration
+ * and returns a handle to the job.
+ * @param client The implementation of MapReduceClient, or in other words,
+ *				 the task that the framework should run.
+ * @param inputVec A vector of pairs (K1*, V1*) that is the input. We assume that it is valid.
+ * @param outputVec A vector to which output elements will be added before returning.
+ *					We assume that it is empty.
+ * @param config The configuration of the job.
+ * @return The JobHandle that will be used for monitoring the job.
+ */
+JobHandle startMapReduceJob(const MapReduceClient& client,
+	const InputVec& inputVec, OutputVec& outputVec,
+	const JobConfig& config);
+
+/**
+ * This function runs the MapReduce algorithm with the given configuration to completion,
+ * with the calling thread working as one of the job's workers instead of waiting idly:
+ * only multiThreadLevel - 1 threads are created, and the caller runs the remaining worker.
+ * The returned handle is of a finished job, which may be queried (e.g. getJobStats, getJobError)
+ * and must be closed with closeJobHandle.
+ * @param client The implementation of MapReduceClient, or in other words,
+ *				 the task that the framework should run.
+ * @param inputVec A vector of pairs (K1*, V1*) that is the input. We assume that it is valid.
+ * @param outputVec A vector to which output elements will be added before returning.
+ *					We assume that it is empty.
+ * @param config The configuration of the job.
+ * @return The JobHandle of the finished job, or nullptr if the input is empty.
+ */
+JobHandle runMapReduceJob(const MapReduceClient& client,
+	const InputVec& inputVec, OutputVec& outputVec,
+	const JobConfig& config);
+
+/**
+ * This function creates a job that can be run any number of times with restartMapReduceJob.
+ * The job keeps all its buffers (including the intermediate segments, in a pool of its own)
+ * between runs, so repeated runs of the same shape do not perform any large allocations.
+ * The job does not run until restartMapReduceJob is called.
+ * @param config The configuration of the job, used for all its runs.
+ * @return The JobHandle that will be used for running and monitoring the job.
+ */
+JobHandle createReusableJob(const JobConfig& config);
+
+/**
+ * This function starts a new run of an existing job, reusing its buffers.
+ * If the previous run of the job is not finished yet, it waits until it is finished.
+ * @param job The JobHandle returned by createReusableJob (or by startMapReduceJob).
+ * @param client The implementation of MapReduceClient, or in other words,
+ *				 the task that the framework should run.
+ * @param inputVec A vector of pairs (K1*, V1*) that is the input. We assume that it is valid.
+ * @param outputVec A vector to which output elements will be added before returning.
+ *					We assume that it is empty.
+ */
+void restartMapReduceJob(JobHandle job, const MapReduceClient& client,
+	const InputVec& inputVec, OutputVec& outputVec);
+
+/**
+ * This function runs an existing job again to completion, reusing its buffers, with the calling
+ * thread working as one of the job's workers (see runMapReduceJob).
+ * If the previous run of the job is not finished yet, it waits until it is finished.
+ * @param job The JobHandle returned by createReusableJob (or by startMapReduceJob).
+ * @param client The implementation of MapReduceClient, or in other words,
+ *				 the task that the framework should run.
+ * @param inputVec A vector of pairs (K1*, V1*) that is the input. We assume that it is valid.
+ * @param outputVec A vector to which output elements will be added before returning.
+ *					We assume that it is empty.
+ */
+void rerunMapReduceJob(JobHandle job, const MapReduceClient& client,
+	const InputVec& inputVec, OutputVec& outputVec);
+
+/**
+ * This function sets an immutable value that all the workers of a job can read through
+ * getBroadcast, without copying it. Must not be called while the job is running; the value
+ * must stay alive and unchanged until the job's run is finished.
+ * @param job The JobHandle returned by createReusableJob.
+ * @param value The value to share, or nullptr.
+ */
+void setJobBroadcast(JobHandle job, const void* value);
+
+/**
+ * This function returns the broadcast value of the job that is calling the client's map or reduce.
+ * @param context The context that was passed from the framework to the client's map or reduce.
+ * @return The value set by setJobBroadcast, or nullptr if none was set.
+ */
+const void* getBroadcast(void* context);
+
+/**
+ * This function checks whether the job failed. A job fails when the client's map or reduce throws
+ * (unless JobConfig::catchMapExceptions handles it), or when its threads cannot be created.
+ * The first error is kept, the other workers stop as soon as they finish their current task, and
+ * the intermediate pairs that were not reduced yet are handed to releaseIntermediate.
+ * The output vector holds whatever was emitted before the error.
+ * @param job The JobHandle of the job.
+ * @param error Set to the job's first error, if it failed.
+ * @return true if the job failed, false otherwise (including while it is running without errors).
+ */
+bool getJobError(JobHandle job, JobError* error);
+
+/**
+ * This function waits like waitForJob, and then rethrows the job's first error, if it failed.
+ * @param job The JobHandle of the job.
+ */
+void waitForJobOrThrow(JobHandle job);
+
+/**
+ * This function gets the input pairs whose map threw on every attempt
+ * (see JobConfig::catchMapExceptions).
+ * @param job The JobHandle of the job.
+ * @param indices A vector to which the indices of the failed pairs in the input vector will be
+ *                added, in ascending order.
+ */
+void getFailedMapInputs(JobHandle job, std::vector<size_t>& indices);
+
+/**
+ * This function checks whether the map call that is calling it was superseded by a duplicate run
+ * of the same input pair (see JobConfig::speculativeMap). A long map call may check it from time
+ * to time and return early, since its output will be discarded anyway.
+ * @param context The context that was passed from the framework to the client's map.
+ * @return true if another run of the same input pair was already kept.
+ */
+bool isMapSuperseded(void* context);
+
 /**
  * This function gets a JobHandle returned by startMapReduceFramework and waits until it is finished.
  * @param job The JobHandle returned by startMapReduceFramework.
@@ -76,6 +474,75 @@ void waitForJob(JobHandle job);
  */
 void getJobState(JobHandle job, JobState* state);
 
+/**
+ * This function estimates the progress of a whole run of a job, from the counters the workers
+ * already keep and the times the stages started at. Safe to call from any thread while the job runs.
+ * @param job The JobHandle returned by startMapReduceFramework.
+ * @param progress A pointer to a JobProgress struct that will be updated with the job's progress.
+ */
+void getJobProgress(JobHandle job, JobProgress* progress);
+
+/**
+ * This function gets a JobHandle and updates the statistics of the job into the given JobStats struct.
+ * @param job The JobHandle returned by startMapReduceFramework.
+ * @param stats A pointer to a JobStats struct that will be updated with the current statistics of the job.
+ */
+void getJobStats(JobHandle job, JobStats* stats);
+
+/**
+ * This function gets the hardware performance counts of a single worker of a job
+ * (see JobConfig::perfCounters).
+ * @param job The JobHandle returned by startMapReduceFramework.
+ * @param worker The index of the worker, below JobConfig::multiThreadLevel.
+ * @param counters Set to the counts of the worker in every phase, or to 0 if it is out of range.
+ */
+void getWorkerPerfCounters(JobHandle job, int worker, PhaseCounters counters[PERF_PHASES]);
+
+/**
+ * A struct which holds the live metrics of the current run of a job, as exposed by MetricsRegistry.
+ * Every count starts over at 0 when the job is run again.
+ *
+ * uint64_t processed[4]: The elements processed in every stage of the current run, indexed by
+ *                        stage_t: input pairs in map, intermediate pairs in shuffle, and groups
+ *                        (or intermediate pairs, in streaming mode) in reduce.
+ *
+ * size_t pendingMapTasks: The input pairs no worker has claimed yet.
+ *
+ * size_t pendingOutputPairs: The output pairs published but not polled yet (see JobConfig::outputQueue).
+ *
+ * size_t pendingIoCalls: The blocking calls waiting for or running on the job's I/O threads.
+ *
+ * uint64_t barrierWaits: The number of times a worker blocked at a barrier in the current run,
+ *                        waiting for the others.
+ *
+ * uint64_t barrierWaitNanos: The total time the workers spent blocked at barriers in the current run.
+ */
+typedef struct {
+	uint64_t processed[4];
+	size_t pendingMapTasks;
+	size_t pendingOutputPairs;
+	size_t pendingIoCalls;
+	uint64_t barrierWaits;
+	uint64_t barrierWaitNanos;
+} JobMetrics;
+
+/**
+ * This function gets the live metrics of a job. Safe to call from any thread while the job runs.
+ * @param job The JobHandle returned by startMapReduceFramework.
+ * @param metrics A pointer to a JobMetrics struct that will be updated with the job's metrics.
+ */
+void getJobMetrics(JobHandle job, JobMetrics* metrics);
+
+/**
+ * This function moves the output elements published so far by a job into the given vector.
+ * Only applies to jobs started with JobConfig::outputQueue; those output elements will not be
+ * added to the job's output vector.
+ * @param job The JobHandle returned by startMapReduceFramework.
+ * @param out A vector to which the published output elements will be added.
+ * @return The number of output elements added to out.
+ */
+size_t pollJobOutput(JobHandle job, OutputVec& out);
+
 /**
  * This function releases all resources of a job.
  *
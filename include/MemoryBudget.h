@@ -0,0 +1,71 @@
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+/**
+ * @class MemoryBudget
+ * @brief A thread-safe account of memory usage against a fixed limit.
+ *
+ * A budget can be given to a single job, or shared by several jobs running side by side.
+ * Charges that would exceed the limit wait for other charges to be released (back-pressure),
+ * and fail if no room is made in time.
+ */
+class MemoryBudget {
+public:
+    /**
+     * @brief Constructs a MemoryBudget with nothing charged.
+     * @param limitBytes The maximal number of bytes that may be charged at once.
+     */
+    explicit MemoryBudget(size_t limitBytes);
+
+    /**
+     * @brief Charges the given number of bytes, if they fit in the budget.
+     *
+     * If they do not fit, the calling thread blocks until enough bytes are released,
+     * or until maxWait passes.
+     * @param bytes The number of bytes to charge.
+     * @param maxWait The maximal time to wait for room in the budget.
+     * @return true if the bytes were charged, false if they did not fit in time.
+     */
+    bool tryCharge(size_t bytes, std::chrono::milliseconds maxWait);
+
+    /**
+     * @brief Charges the given number of bytes, even if they exceed the limit.
+     * @param bytes The number of bytes to charge.
+     */
+    void charge(size_t bytes);
+
+    /**
+     * @brief Releases previously charged bytes, waking up the threads waiting for room.
+     * @param bytes The number of bytes to release.
+     */
+    void release(size_t bytes);
+
+    /**
+     * @return The number of bytes currently charged.
+     */
+    size_t used();
+
+    /**
+     * @return The largest number of bytes that were charged at once.
+     */
+    size_t highWater();
+
+    /**
+     * @return The maximal number of bytes that may be charged at once.
+     */
+    [[nodiscard]] size_t limit() const;
+
+private:
+    std::mutex mutex;  // Mutex for the counters
+    std::condition_variable cv;  // Signalled whenever bytes are released
+    size_t usedBytes;  // Bytes currently charged
+    size_t highWaterBytes;  // Most bytes charged at once
+    const size_t limitBytes;  // Maximal bytes charged at once
+};
+
+#endif //MEMORYBUDGET_H
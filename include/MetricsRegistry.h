@@ -0,0 +1,106 @@
+#ifndef METRICSREGISTRY_H
+#define METRICSREGISTRY_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MapReduceFramework.h"
+
+#define METRICS_CONTENT_TYPE "text/plain; version=0.0.4; charset=utf-8"
+
+/**
+ * @class MetricsRegistry
+ * @brief Exposes the metrics of running jobs in the Prometheus text exposition format.
+ *
+ * Jobs started with JobConfig::metrics set to a registry are added to it when they are created,
+ * and removed when their handle is closed. Every scrape reads the current counters and gauges of
+ * all the registered jobs (see getJobMetrics), so monitoring costs nothing between scrapes.
+ * The values of a job describe its current run, so they are exposed as gauges which start over
+ * when a reusable or iterative job runs again.
+ *
+ * The registry may also serve its metrics over HTTP on a local port, for a Prometheus server or
+ * any other scraper to poll.
+ * All the methods are thread-safe.
+ */
+class MetricsRegistry {
+public:
+    MetricsRegistry();
+
+    /**
+     * @brief Stops the HTTP listener, if it was started.
+     * Every job registered with the registry must be closed before it is destroyed.
+     */
+    ~MetricsRegistry();
+
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    /**
+     * @brief Registers a job. Called by the framework when the job is created.
+     * @param job The job's handle.
+     * @param name The value of the job's "job" label, or nullptr to name it by its registration order.
+     */
+    void addJob(JobHandle job, const char* name);
+
+    /**
+     * @brief Unregisters a job. Called by the framework when the job's handle is closed, and
+     *        waits for any scrape that is reading the job.
+     * @param job The job's handle.
+     */
+    void removeJob(JobHandle job);
+
+    /**
+     * @brief Writes the metrics of all the registered jobs.
+     * @return The metrics in the Prometheus text exposition format (version 0.0.4).
+     */
+    [[nodiscard]] std::string scrape() const;
+
+    /**
+     * @brief Starts serving the metrics over HTTP on the loopback interface. Any path is
+     *        answered with scrape(), which is what Prometheus expects of a /metrics endpoint.
+     * @param port The TCP port to listen on, or 0 to let the system pick one (see port()).
+     * @return false if the listener could not be started (e.g. the port is taken, or it is
+     *         already serving).
+     */
+    bool serve(int port);
+
+    /**
+     * @brief Stops serving the metrics over HTTP, waiting for the listener to exit.
+     */
+    void stopServing();
+
+    /**
+     * @return The TCP port the metrics are served on, or 0 if they are not served.
+     */
+    [[nodiscard]] int port() const;
+
+private:
+    struct Entry {
+        JobHandle job;
+        std::string name;
+    };
+
+    /**
+     * @brief The function of the listener thread: answers connections until stopServing().
+     */
+    void listen();
+
+    /**
+     * @brief Answers a single HTTP request.
+     * @param connection The socket of the connection, which is closed by the caller.
+     */
+    void answer(int connection) const;
+
+    mutable std::mutex mutex;  // Mutex for the registered jobs, held while scraping them
+    std::vector<Entry> jobs;  // The registered jobs
+    size_t jobsStarted;  // The number of jobs ever registered
+    int listenFd;  // The listening socket, or -1
+    std::atomic<int> listenPort;  // The port of the listening socket, or 0
+    std::atomic<bool> stopping;  // Set to stop the listener thread
+    std::thread listener;  // The listener thread, if serving
+    std::mutex serveMutex;  // Mutex for starting and stopping the listener
+};
+
+#endif //METRICSREGISTRY_H
@@ -0,0 +1,85 @@
+#ifndef OUTPUTQUEUE_H
+#define OUTPUTQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include "MapReduceClient.h"
+
+#define OUTPUT_CHUNK_CAPACITY 256
+
+/**
+ * A fixed-size chunk of output pairs, filled by a single thread and then published as a whole.
+ */
+struct OutputChunk {
+    OutputPair pairs[OUTPUT_CHUNK_CAPACITY];
+    size_t size = 0;
+    std::atomic<OutputChunk*> next{nullptr};
+};
+
+/**
+ * @class OutputQueue
+ * @brief A multi-producer, single-consumer queue of output pairs.
+ *
+ * Every producer fills its own chunk without any synchronization, and links the chunk to the
+ * queue once it is full. Linking is wait-free: a single atomic exchange of the tail, after
+ * which the previous tail is pointed at the new chunk (the intrusive MPSC queue by D. Vyukov).
+ * The consumer can drain the published chunks while the producers keep emitting.
+ */
+class OutputQueue {
+public:
+    /**
+     * @brief Constructs an empty OutputQueue.
+     */
+    OutputQueue();
+
+    /**
+     * @brief Frees all the chunks that were not drained.
+     * The pairs in them are not deleted, as they are owned by the client.
+     */
+    ~OutputQueue();
+
+    OutputQueue(const OutputQueue&) = delete;
+    OutputQueue& operator=(const OutputQueue&) = delete;
+
+    /**
+     * @brief Appends a pair to the producer's chunk, and publishes the chunk when it is full.
+     * @param chunk The producer's current chunk, or nullptr if it has none. Updated in place.
+     * @param key The key of the output element.
+     * @param value The value of the output element.
+     */
+    void emit(OutputChunk*& chunk, K3* key, V3* value);
+
+    /**
+     * @brief Publishes the producer's chunk even if it is not full.
+     * @param chunk The producer's current chunk, or nullptr if it has none. Reset to nullptr.
+     */
+    void flush(OutputChunk*& chunk);
+
+    /**
+     * @brief Moves all the published pairs to the given vector, in publishing order.
+     *
+     * Must not be called by more than one thread at a time.
+     * @param out The vector to which the pairs are appended.
+     * @return The number of pairs appended.
+     */
+    size_t drain(OutputVec& out);
+
+    /**
+     * @brief Counts the output pairs which were published but not drained yet.
+     * @return The number of pending pairs.
+     */
+    [[nodiscard]] size_t pending() const;
+
+private:
+    /**
+     * @brief Links a chunk at the tail of the queue.
+     * @param chunk The chunk to link.
+     */
+    void push(OutputChunk* chunk);
+
+    std::atomic<OutputChunk*> tail;  // The last linked chunk, swapped by the producers
+    OutputChunk* head;  // The last drained chunk (or the initial stub), owned by the consumer
+    std::atomic<size_t> pendingPairs;  // Pairs published but not drained yet
+};
+
+#endif //OUTPUTQUEUE_H
@@ -0,0 +1,70 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <array>
+#include <cstdint>
+#include "MapReduceFramework.h"
+
+/**
+ * @class PerfCounters
+ * @brief The hardware performance counters of the calling thread, read around each phase of a worker.
+ *
+ * On Linux, every event of PhaseCounters is opened with perf_event_open for the thread that
+ * constructs the object, counting user-space activity only. An event that cannot be opened (no
+ * PMU in a virtual machine, a restrictive perf_event_paranoid, or another OS) is simply left
+ * out, and available() tells which events are counted. The wall time of every phase is measured
+ * whenever the counters are enabled.
+ * The object must only be used by the thread that constructed it.
+ */
+class PerfCounters {
+public:
+    /**
+     * @brief Opens the counters of the calling thread, if enabled.
+     * @param enabled Whether to open the counters at all.
+     */
+    explicit PerfCounters(bool enabled);
+
+    /**
+     * @brief Closes the counters.
+     */
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /**
+     * @return The PERF_EVENT_* bits of the events that are counted.
+     */
+    [[nodiscard]] unsigned available() const;
+
+    /**
+     * @brief Starts measuring a phase.
+     */
+    void start();
+
+    /**
+     * @return Whether the counters were enabled, so that the phases are measured.
+     */
+    [[nodiscard]] bool enabled() const;
+
+    /**
+     * @brief Ends the phase started by start(), adding the counts since then to counters.
+     * @param counters The counters of the phase.
+     */
+    void stop(PhaseCounters& counters);
+
+private:
+    /**
+     * @brief Reads the current value of every counted event, scaled up if the kernel had to
+     *        multiplex the counters.
+     * @param values Set to the value of every event, or 0 for the events that are not counted.
+     */
+    void read(std::array<uint64_t, PERF_EVENTS>& values) const;
+
+    std::array<int, PERF_EVENTS> fds;  // The file descriptor of every event, or -1
+    std::array<uint64_t, PERF_EVENTS> startValues;  // The values read by start()
+    const bool measuring;  // Whether the counters were enabled
+    int64_t startTime;  // The steady_clock time of start(), in nanoseconds
+};
+
+#endif //PERFCOUNTERS_H
@@ -0,0 +1,152 @@
+#ifndef SEGMENTEDBUFFER_H
+#define SEGMENTEDBUFFER_H
+
+#include <mutex>
+#include <vector>
+#include "MapReduceClient.h"
+
+#define SEGMENT_BYTES (64 * 1024)
+#define SEGMENT_CAPACITY (SEGMENT_BYTES / sizeof(IntermediatePair))
+#define SEGMENT_POOL_MAX_CACHED 1024 // Free segments kept for reuse (64 MiB), the rest are freed
+
+/**
+ * @class SegmentPool
+ * @brief A pool of fixed-size segments of intermediate pairs.
+ *
+ * Segments released by one buffer (or one job) are handed to the next buffer that needs one,
+ * so steady-state jobs do not go back to the allocator for their intermediate data.
+ * Jobs share a process-wide pool, while reusable jobs keep a pool of their own.
+ */
+class SegmentPool {
+public:
+    /**
+     * @brief Constructs an empty SegmentPool.
+     * @param maxCached The maximal number of free segments kept for reuse, the rest are freed.
+     */
+    explicit SegmentPool(size_t maxCached);
+
+    /**
+     * @return The process-wide pool.
+     */
+    static SegmentPool& instance();
+
+    /**
+     * @brief Takes a free segment from the pool, or allocates a new one if the pool is empty.
+     * @return Uninitialized storage for SEGMENT_CAPACITY intermediate pairs.
+     */
+    IntermediatePair* acquire();
+
+    /**
+     * @brief Returns a segment to the pool.
+     * @param segment A segment previously returned by acquire.
+     */
+    void release(IntermediatePair* segment);
+
+    ~SegmentPool();
+
+    SegmentPool(const SegmentPool&) = delete;
+    SegmentPool& operator=(const SegmentPool&) = delete;
+
+private:
+    std::mutex mutex;  // Mutex for the free list
+    std::vector<IntermediatePair*> freeSegments;  // Segments ready for reuse
+    const size_t maxCached;  // Maximal number of free segments kept for reuse
+};
+
+/**
+ * @class SegmentedBuffer
+ * @brief A sequence of intermediate pairs, stored in fixed-size segments taken from the SegmentPool.
+ *
+ * Unlike a vector, the buffer never relocates its pairs when it grows: it only takes another
+ * segment. Sorting is done segment by segment, followed by a merge of the sorted segments.
+ */
+class SegmentedBuffer {
+public:
+    /**
+     * @brief Constructs an empty SegmentedBuffer.
+     * @param pool The pool from which the buffer takes its segments.
+     */
+    explicit SegmentedBuffer(SegmentPool* pool = &SegmentPool::instance());
+
+    /**
+     * @brief Returns all the segments of the buffer to the pool.
+     */
+    ~SegmentedBuffer();
+
+    SegmentedBuffer(const SegmentedBuffer&) = delete;
+    SegmentedBuffer& operator=(const SegmentedBuffer&) = delete;
+    SegmentedBuffer(SegmentedBuffer&& other) noexcept;
+    SegmentedBuffer& operator=(SegmentedBuffer&& other) noexcept;
+
+    /**
+     * @brief Appends a pair at the end of the buffer.
+     * @param key The key of the pair.
+     * @param value The value of the pair.
+     */
+    void emplace_back(K2* key, V2* value);
+
+    /**
+     * @return The last pair of the buffer. The buffer must not be empty.
+     */
+    [[nodiscard]] const IntermediatePair& back() const;
+
+    /**
+     * @brief Removes the last pair of the buffer,
+     *        returning its segment to the pool once the segment is empty.
+     */
+    void pop_back();
+
+    /**
+     * @param index The index of the pair, smaller than size().
+     * @return The pair at the given index.
+     */
+    [[nodiscard]] const IntermediatePair& operator[](size_t index) const;
+
+    /**
+     * @return The number of pairs in the buffer.
+     */
+    [[nodiscard]] size_t size() const;
+
+    /**
+     * @return true if the buffer holds no pairs, false otherwise.
+     */
+    [[nodiscard]] bool empty() const;
+
+    /**
+     * @return The number of pairs the buffer can hold without taking another segment.
+     */
+    [[nodiscard]] size_t capacity() const;
+
+    /**
+     * @brief Takes enough segments from the pool to hold the given number of pairs.
+     * @param capacity The number of pairs the buffer should be able to hold.
+     */
+    void reserve(size_t capacity);
+
+    /**
+     * @brief Removes all the pairs and returns all the segments to the pool.
+     */
+    void clear();
+
+    /**
+     * @brief Sorts the pairs by their keys.
+     *
+     * Every segment is sorted on its own, in place, and then the sorted segments are merged into
+     * new segments. Every original segment is returned to the pool as soon as all its pairs are
+     * merged. If a comparison throws, the buffer is left holding all its pairs (in an unspecified
+     * order): the pairs merged so far, followed by the ones that were not merged yet.
+     */
+    void sort();
+
+private:
+    /**
+     * @brief Returns the segments beyond the ones needed for the current pairs to the pool.
+     */
+    void trim();
+
+    SegmentPool* pool;  // The pool from which the segments are taken
+    std::vector<IntermediatePair*> segments;  // The segments, in order
+    size_t count = 0;  // The number of pairs in the buffer
+};
+
+#endif //SEGMENTEDBUFFER_H
@@ -0,0 +1,54 @@
+
+#include "../include/Aggregators.h"
+
+#include <algorithm>
+#include <limits>
+
+Aggregate::Aggregate() : sum(0), min(std::numeric_limits<double>::infinity()),
+                         max(-std::numeric_limits<double>::infinity()), numValues(0) {}
+
+void Aggregate::add(const double value) {
+    sum += value;
+    min = std::min(min, value);
+    max = std::max(max, value);
+    ++numValues;
+}
+
+double Aggregate::result(const aggregate_t kind) const {
+    if (numValues == 0) {
+        return 0; // An empty aggregate has no meaningful min, max or average
+    }
+    switch (kind) {
+        case AGGREGATE_SUM:
+            return sum;
+        case AGGREGATE_COUNT:
+            return static_cast<double>(numValues);
+        case AGGREGATE_MIN:
+            return min;
+        case AGGREGATE_MAX:
+            return max;
+        case AGGREGATE_AVG:
+            return sum / static_cast<double>(numValues);
+    }
+    return 0;
+}
+
+uint64_t Aggregate::count() const {
+    return numValues;
+}
+
+void AggregatingClient::reduce(const IntermediateVec* pairs, void* context) const {
+    if (pairs->empty()) {
+        return; // Nothing to aggregate
+    }
+    Aggregate folded;
+    for (const auto&[fst, snd] : *pairs) {
+        folded.add(static_cast<const NumericValue*>(snd)->value);
+    }
+    // The first key represents the group, every other consumed object is released
+    K2* groupKey = pairs->front().first;
+    for (const auto&[fst, snd] : *pairs) {
+        releaseIntermediate(fst == groupKey ? nullptr : fst, snd);
+    }
+    emitAggregate(groupKey, folded.result(aggregate()), context);
+}
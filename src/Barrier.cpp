@@ -1,8 +1,14 @@
 #include "../include/Barrier.h"
 
-Barrier::Barrier(const int numThreads): count(0), generation(0), numThreads(numThreads) {}
+#include <chrono>
+
+Barrier::Barrier(const int numThreads)
+    : count(0), generation(0), numThreads(numThreads), waitCount(0), waitTime(0) {}
 
 void Barrier::barrier() {
+    if (numThreads == 1) {
+        return; // A single thread has no one to wait for
+    }
     std::unique_lock<std::mutex> lock(mutex); // Lock the mutex to ensure thread safety
     int gen = generation;
 
@@ -10,7 +16,11 @@ void Barrier::barrier() {
         // If not all threads have reached the barrier, wait for others to arrive.
         // The predicate ensures that we only wake up when the generation has changed,
         // indicating that all threads have reached the barrier.
+        const auto start = std::chrono::steady_clock::now();
         cv.wait(lock, [this, gen] { return gen != generation; });
+        waitCount.fetch_add(1, std::memory_order_relaxed);
+        waitTime.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
     } else {
         // If all threads have reached the barrier,
         // reset the count and increment the ageneration.
@@ -19,3 +29,16 @@ void Barrier::barrier() {
         cv.notify_all(); // Notify all waiting threads that the barrier has been crossed.
     }
 }
+
+uint64_t Barrier::waits() const {
+    return waitCount.load(std::memory_order_relaxed);
+}
+
+uint64_t Barrier::waitNanos() const {
+    return waitTime.load(std::memory_order_relaxed);
+}
+
+void Barrier::resetWaits() {
+    waitCount.store(0, std::memory_order_relaxed);
+    waitTime.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,73 @@
+#include "../include/FairScheduler.h"
+
+#include <algorithm>
+
+#define STRIDE_SCALE (1ULL << 20) // The stride of a job of weight 1
+
+FairScheduler::FairScheduler(const int slots)
+    : totalSlots(slots), freeSlots(slots), virtualTime(0), nextJobId(0) {}
+
+int FairScheduler::addJob(const int priority, const int weight) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const int job = nextJobId++;
+    // A new job starts at the current virtual time, so it cannot claim the slots it "missed"
+    shares.emplace(job, Share{priority, STRIDE_SCALE / std::max(weight, 1), virtualTime, 0, 0});
+    return job;
+}
+
+void FairScheduler::removeJob(const int job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shares.erase(job);
+    }
+    cv.notify_all();
+}
+
+void FairScheduler::acquire(const int job) {
+    std::unique_lock<std::mutex> lock(mutex);
+    Share& share = shares.at(job);
+    if (share.waiting == 0 && share.running == 0) {
+        // Same as a new job: an idle job does not get to catch up on the time it was idle
+        share.pass = std::max(share.pass, virtualTime);
+    }
+    ++share.waiting;
+    cv.wait(lock, [this, job] { return freeSlots > 0 && isNext(job); });
+    --share.waiting;
+    ++share.running;
+    --freeSlots;
+    virtualTime = share.pass;
+    share.pass += share.stride;
+    if (freeSlots > 0) {
+        cv.notify_all(); // The next job in line may take one of the remaining slots
+    }
+}
+
+void FairScheduler::release(const int job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        --shares.at(job).running;
+        ++freeSlots;
+    }
+    cv.notify_all();
+}
+
+int FairScheduler::slots() const {
+    return totalSlots;
+}
+
+bool FairScheduler::isNext(const int job) const {
+    const Share& share = shares.at(job);
+    for (const auto& [other, otherShare] : shares) {
+        if (other == job || otherShare.waiting == 0) {
+            continue;
+        }
+        if (otherShare.priority != share.priority) {
+            if (otherShare.priority > share.priority) {
+                return false;
+            }
+        } else if (otherShare.pass < share.pass || (otherShare.pass == share.pass && other < job)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,43 @@
+#include "../include/IoExecutor.h"
+
+IoExecutor::IoExecutor(const int numThreads) : stopping(false) {
+    threads.reserve(numThreads);
+    for (int i = 0; i < numThreads; ++i) {
+        threads.emplace_back([this] { run(); });
+    }
+}
+
+IoExecutor::~IoExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void IoExecutor::submit(std::function<void()> call) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        calls.push_back(std::move(call));
+    }
+    cv.notify_one();
+}
+
+void IoExecutor::run() {
+    while (true) {
+        std::function<void()> call;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this] { return stopping || !calls.empty(); });
+            if (calls.empty()) {
+                return; // Stopping, and every submitted call was already run
+            }
+            call = std::move(calls.front());
+            calls.pop_front();
+        }
+        call(); // Run the call without holding the lock, so other threads can take calls
+    }
+}
@@ -0,0 +1,28 @@
+#include "../include/IterativeJob.h"
+
+int runIterativeJob(const IterativeClient& client, InputVec& input, OutputVec& output,
+                    const JobConfig& config, const int maxIterations) {
+    JobHandle job = createReusableJob(config);
+    int iteration = 0;
+    while (iteration < maxIterations) {
+        // The broadcast value is set while no worker is running, so they can read it freely
+        setJobBroadcast(job, client.broadcast(iteration));
+        rerunMapReduceJob(job, client, input, output); // The caller works as one of the workers
+
+        // A failed iteration leaves partial output, which must not be fed back or checked for convergence
+        JobStats stats;
+        getJobStats(job, &stats);
+        if (JobError error; stats.memoryBudgetExceeded || getJobError(job, &error)) {
+            closeJobHandle(job);
+            return ITERATIVE_JOB_FAILED;
+        }
+
+        if (client.converged(iteration++, output) || iteration == maxIterations) {
+            break; // The output of this iteration is the final output
+        }
+        client.feedback(output, input);
+        output.clear();
+    }
+    closeJobHandle(job);
+    return iteration;
+}
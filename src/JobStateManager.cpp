@@ -1,28 +1,46 @@
 
 #include "../include/JobStateManager.h"
 
+#include <chrono>
+
 #define STAGE_MASK 0x3
 #define STAGE_SHIFT 62
 #define PROCESSED_SHIFT 31
 #define MAX_31_BITS 0x7FFF'FFFF
 
-JobStateManager::JobStateManager(const uint32_t totalKeys) : state(0) {
+JobStateManager::JobStateManager(const uint32_t totalKeys) : state(0), finalProcessed(), stageStarts() {
     state.store(encodeState(UNDEFINED_STAGE, 0, totalKeys), std::memory_order_release);
 }
 
 void JobStateManager::updateState(const stage_t stage, const uint32_t processed,
                                   const uint32_t total) {
+    recordTransition(state.load(std::memory_order_acquire), stage);
     state.store(encodeState(stage, processed, total), std::memory_order_release);
 }
 
-void JobStateManager::incrementProcessed() {
+void JobStateManager::recordTransition(const uint64_t oldVal, const stage_t newStage) {
+    const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (newStage == UNDEFINED_STAGE) {
+        for (int stage = 0; stage < 4; ++stage) {
+            finalProcessed[stage].store(0, std::memory_order_relaxed); // A new run starts
+            stageStarts[stage].store(0, std::memory_order_relaxed);
+        }
+        stageStarts[UNDEFINED_STAGE].store(now, std::memory_order_relaxed);
+    } else if (const stage_t oldStage = decodeStage(oldVal); oldStage != newStage) {
+        finalProcessed[oldStage].store(decodeProcessed(oldVal), std::memory_order_relaxed);
+        stageStarts[newStage].store(now, std::memory_order_relaxed);
+    }
+}
+
+void JobStateManager::incrementProcessed(const uint32_t amount) {
     uint64_t oldVal = state.load(std::memory_order_acquire);
     while (true) {
         const stage_t stage = decodeStage(oldVal);
         const uint32_t processed = decodeProcessed(oldVal);
         const uint32_t total = decodeTotal(oldVal);
 
-        if (const uint64_t newVal = encodeState(stage, processed + 1, total);
+        if (const uint64_t newVal = encodeState(stage, processed + amount, total);
             state.compare_exchange_weak(
                 oldVal, newVal,
                 std::memory_order_acq_rel,
@@ -52,6 +70,7 @@ void JobStateManager::setStage(const stage_t newStage) {
     uint64_t oldVal = state.load(std::memory_order_acquire);
     while (true) {
         const uint32_t total = decodeTotal(oldVal);
+        recordTransition(oldVal, newStage);
 
         if (const uint64_t newVal = encodeState(newStage, 0, total);
             state.compare_exchange_weak(
@@ -63,6 +82,23 @@ void JobStateManager::setStage(const stage_t newStage) {
     }
 }
 
+bool JobStateManager::advanceStage(const stage_t oldStage, const stage_t newStage) {
+    uint64_t oldVal = state.load(std::memory_order_acquire);
+    while (decodeStage(oldVal) == oldStage) {
+        const uint32_t total = decodeTotal(oldVal);
+        recordTransition(oldVal, newStage);
+
+        if (const uint64_t newVal = encodeState(newStage, 0, total);
+            state.compare_exchange_weak(
+                oldVal, newVal,
+                std::memory_order_acq_rel,
+                std::memory_order_acquire)) {
+            return true;
+                }
+    }
+    return false;
+}
+
 void JobStateManager::getState(stage_t &outStage, uint32_t &outProcessed,
                                uint32_t &outTotal) const {
     const uint64_t packed = state.load(std::memory_order_acquire);
@@ -71,6 +107,17 @@ void JobStateManager::getState(stage_t &outStage, uint32_t &outProcessed,
     outTotal = decodeTotal(packed);
 }
 
+uint32_t JobStateManager::getProcessed(const stage_t stage) const {
+    if (const uint64_t packed = state.load(std::memory_order_acquire); decodeStage(packed) == stage) {
+        return decodeProcessed(packed);
+    }
+    return finalProcessed[stage].load(std::memory_order_relaxed);
+}
+
+int64_t JobStateManager::getStageStart(const stage_t stage) const {
+    return stageStarts[stage].load(std::memory_order_relaxed);
+}
+
 uint64_t JobStateManager::encodeState(const stage_t stage, const uint32_t processed,
                                       const uint32_t total) {
     return (static_cast<uint64_t>(stage & STAGE_MASK) << STAGE_SHIFT)
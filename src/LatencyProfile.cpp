@@ -0,0 +1,179 @@
+#include "../include/LatencyProfile.h"
+
+#include <algorithm>
+#include <mutex>
+
+#define CALIBRATION_TIME std::chrono::milliseconds(1) // Time spent measuring the tick rate
+
+/**
+ * Measures how many nanoseconds a tick of readTicks lasts.
+ * @return The length of a tick in nanoseconds.
+ */
+static double calibrateNanosPerTick() {
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+    const auto startTime = std::chrono::steady_clock::now();
+    const uint64_t startTicks = readTicks();
+    auto now = startTime;
+    while (now - startTime < CALIBRATION_TIME) {
+        now = std::chrono::steady_clock::now();
+    }
+    const uint64_t ticks = readTicks() - startTicks;
+    const auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(now - startTime).count();
+    return ticks == 0 ? 1.0 : static_cast<double>(nanos) / static_cast<double>(ticks);
+#else
+    return 1.0; // readTicks already counts nanoseconds
+#endif
+}
+
+uint64_t ticksToNanos(const uint64_t ticks) {
+    static std::once_flag calibrated;
+    static double nanosPerTick;
+    std::call_once(calibrated, [] { nanosPerTick = calibrateNanosPerTick(); });
+    return static_cast<uint64_t>(static_cast<double>(ticks) * nanosPerTick);
+}
+
+LatencyHistogram::LatencyHistogram() : counts(), total(0), sum(0), minValue(UINT64_MAX), maxValue(0) {}
+
+size_t LatencyHistogram::bucketOf(const uint64_t value) {
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+        return value; // Small values get a bucket each
+    }
+    const int exponent = 63 - __builtin_clzll(value);
+    const int shift = exponent - HISTOGRAM_SUB_BUCKET_BITS;
+    const uint64_t subBucket = (value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1);
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS + subBucket;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(const size_t bucket) {
+    if (bucket < HISTOGRAM_SUB_BUCKETS) {
+        return bucket;
+    }
+    const size_t shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+    const uint64_t subBucket = bucket % HISTOGRAM_SUB_BUCKETS;
+    const uint64_t lower = (HISTOGRAM_SUB_BUCKETS + subBucket) << shift;
+    return lower + ((uint64_t{1} << shift) - 1);
+}
+
+void LatencyHistogram::record(const uint64_t nanos) {
+    ++counts[bucketOf(nanos)];
+    ++total;
+    sum += nanos;
+    minValue = std::min(minValue, nanos);
+    maxValue = std::max(maxValue, nanos);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    sum += other.sum;
+    minValue = std::min(minValue, other.minValue);
+    maxValue = std::max(maxValue, other.maxValue);
+}
+
+void LatencyHistogram::clear() {
+    counts.fill(0);
+    total = 0;
+    sum = 0;
+    minValue = UINT64_MAX;
+    maxValue = 0;
+}
+
+uint64_t LatencyHistogram::count() const {
+    return total;
+}
+
+uint64_t LatencyHistogram::min() const {
+    return total == 0 ? 0 : minValue;
+}
+
+uint64_t LatencyHistogram::max() const {
+    return maxValue;
+}
+
+double LatencyHistogram::mean() const {
+    return total == 0 ? 0 : static_cast<double>(sum) / static_cast<double>(total);
+}
+
+uint64_t LatencyHistogram::percentile(const double percentile) const {
+    if (total == 0) {
+        return 0;
+    }
+    // The rank of the percentile, counting from 1
+    const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(
+        std::clamp(percentile, 0.0, 100.0) / 100.0 * static_cast<double>(total) + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(bucketUpperBound(i), maxValue);
+        }
+    }
+    return maxValue;
+}
+
+/**
+ * Orders slow calls so that the fastest one is at the top of a heap.
+ */
+static bool slowerThan(const SlowTask& a, const SlowTask& b) {
+    return a.nanos > b.nanos;
+}
+
+TaskProfile::TaskProfile(const size_t maxSlowest) : maxSlowest(maxSlowest) {
+    slowestHeap.reserve(maxSlowest);
+}
+
+void TaskProfile::record(const stage_t stage, const size_t index, const uint64_t nanos) {
+    (stage == MAP_STAGE ? mapHistogram : reduceHistogram).record(nanos);
+    if (maxSlowest > 0 && (slowestHeap.size() < maxSlowest || nanos > slowestHeap.front().nanos)) {
+        offer(SlowTask{stage, index, nanos});
+    }
+}
+
+void TaskProfile::offer(const SlowTask& task) {
+    if (slowestHeap.size() == maxSlowest) {
+        if (task.nanos <= slowestHeap.front().nanos) {
+            return;
+        }
+        std::pop_heap(slowestHeap.begin(), slowestHeap.end(), slowerThan);
+        slowestHeap.pop_back();
+    }
+    slowestHeap.push_back(task);
+    std::push_heap(slowestHeap.begin(), slowestHeap.end(), slowerThan);
+}
+
+void TaskProfile::merge(const TaskProfile& other) {
+    mapHistogram.merge(other.mapHistogram);
+    reduceHistogram.merge(other.reduceHistogram);
+    if (maxSlowest == 0) {
+        return;
+    }
+    for (const SlowTask& task : other.slowestHeap) {
+        offer(task);
+    }
+}
+
+void TaskProfile::clear() {
+    mapHistogram.clear();
+    reduceHistogram.clear();
+    slowestHeap.clear();
+}
+
+const LatencyHistogram& TaskProfile::mapLatency() const {
+    return mapHistogram;
+}
+
+const LatencyHistogram& TaskProfile::reduceLatency() const {
+    return reduceHistogram;
+}
+
+size_t TaskProfile::maxSlowestTasks() const {
+    return maxSlowest;
+}
+
+std::vector<SlowTask> TaskProfile::slowest() const {
+    std::vector<SlowTask> tasks = slowestHeap;
+    std::sort(tasks.begin(), tasks.end(), slowerThan);
+    return tasks;
+}
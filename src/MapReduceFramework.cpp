@@ -2,18 +2,109 @@
 #include "../include/MapReduceFramework.h"
 #include "../include/JobStateManager.h"
 #include "../include/Barrier.h"
+#include "../include/Aggregators.h"
+#include "../include/OutputQueue.h"
+#include "../include/SegmentedBuffer.h"
+#include "../include/MemoryBudget.h"
+#include "../include/AsyncMap.h"
+#include "../include/IoExecutor.h"
+#include "../include/FairScheduler.h"
+#include "../include/LatencyProfile.h"
+#include "../include/PerfCounters.h"
+#include "../include/MetricsRegistry.h"
 
 #include <atomic>
-#include <iostream>
+#include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <thread>
 #include <algorithm>
+#include <array>
 
-#define SYS_ERR "system error: %s\n"
 #define THREAD_ZERO 0
+#define RANGES_PER_THREAD 4 // Key ranges per worker in streaming mode, to balance uneven ranges
+#define SAMPLES_PER_RANGE 8 // Sampled keys per key range when choosing the range boundaries
+#define FANOUT_SAMPLE_INPUTS 16 // Map calls a thread makes before estimating its emit fan-out
+#define DIGEST_OFFSET 0xcbf29ce484222325ULL // FNV-1a offset basis, the digest of an empty output
+#define DIGEST_PRIME 0x100000001b3ULL // FNV-1a prime
+#define RESERVE_SLACK 1.125 // Headroom on top of the expected intermediate vector size
+#define MEMORY_CHARGE_QUANTUM SEGMENT_BYTES // Bytes a thread charges to the budget at a time
+#define SCHEDULER_BATCH_TASKS 32 // Tasks a thread runs per scheduler slot before giving it back
+#define ADAPTIVE_INITIAL_THREADS 2 // Active workers at the start of a phase in adaptive mode
+#define ADAPT_INTERVAL std::chrono::milliseconds(10) // Time between throughput samples
+#define ADAPT_MIN_GAIN 1.1 // Throughput ratio that more workers must reach to be kept
+#define SPECULATION_FACTOR 4 // How many times the median a map call runs before it is duplicated
+#define SPECULATION_MIN_AGE std::chrono::milliseconds(1) // Map calls younger than this are not duplicated
+#define SPECULATION_POLL std::chrono::microseconds(200) // Idle time between searches for stragglers
+#define DURATION_BUCKETS 64 // Buckets of the map call durations histogram, by powers of 2 nanoseconds
+#define NO_TASK UINT32_MAX // The task index of a worker which is not mapping
+#define TASK_SPECULATED 1 // Task state bit: a duplicate of the task was started
+#define TASK_COMMITTED 2 // Task state bit: the output of one of the task's runs was kept
+#define LAUNCH_PENDING 0 // Launch state: the threads are being created
+#define LAUNCH_READY 1 // Launch state: all the threads were created
+#define LAUNCH_FAILED 2 // Launch state: some thread could not be created
+
+#define DEFAULT_SHUFFLE_COST 0.25 // Expected shuffle duration relative to the map's, until a run is measured
+#define DEFAULT_REDUCE_COST 0.5 // Expected reduce duration relative to the map's, until a run is measured
+#define NANOS_PER_SECOND 1e9
 
 static std::mutex jobCreationMutex; // Global mutex to synchronize access to startMapReduceJob
 
+/**
+ * A range of keys in the sorted intermediate vectors, which a single worker merges and reduces
+ * in streaming mode. The range covers [begin[i], end[i]) of the i-th intermediate vector.
+ */
+struct KeyRange {
+	std::vector<size_t> begin;
+	std::vector<size_t> end;
+};
+
+/**
+ * The state of the search for the best number of active workers in a phase, in adaptive mode.
+ * Only touched by thread 0, which is always active.
+ */
+struct Adaptation {
+	std::chrono::steady_clock::time_point sampleTime; // When the last throughput sample was taken
+	uint32_t sampleProcessed; // The processed count of the phase at the last sample
+	double bestThroughput; // The highest throughput measured in the phase, in tasks per second
+	int bestLevel; // The number of active workers which reached bestThroughput
+	bool settled; // Set once adding workers stopped helping
+	int maxLevel; // The most workers the phase may run on
+};
+
+/**
+ * The map call a worker is running, read by idle workers looking for stragglers in speculative mode.
+ */
+struct RunningTask {
+	std::atomic<uint32_t> index; // The index of the input pair, or NO_TASK. Published after since
+	std::atomic<int64_t> since; // When the call started, in steady_clock nanoseconds
+};
+
+/**
+ * The map tasks of a single worker whose blocking calls have returned, waiting to be resumed.
+ * Pushed by the I/O threads and popped by the worker that owns the tasks.
+ */
+struct CompletionQueue {
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<std::coroutine_handle<MapTask::promise_type>> tasks;
+
+	void push(const std::coroutine_handle<MapTask::promise_type> task) {
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(task);
+		// Notified under the lock, since the worker may destroy the queue as soon as it pops the last task
+		cv.notify_one();
+	}
+
+	std::coroutine_handle<MapTask::promise_type> pop() {
+		std::unique_lock<std::mutex> lock(mutex);
+		cv.wait(lock, [this] { return !tasks.empty(); });
+		const auto task = tasks.front();
+		tasks.pop_front();
+		return task;
+	}
+};
+
 /**
  * A struct which includes all the parameters which are relevant to the job.
  */
@@ -27,21 +118,139 @@ struct JobContext {
 	// Barrier to sync all threads before shuffle
 	std::unique_ptr<Barrier> barrier;
 
-	// Input and output vectors
-	const InputVec& inputVec;
-	OutputVec& outputVec;
+	// Input and output vectors of the current run
+	const InputVec* inputVec;
+	OutputVec* outputVec;
+
+	// An immutable value shared by all the workers (see setJobBroadcast)
+	const void* broadcast;
 
 	std::mutex outMutex; // Mutex for output vector
 
+	// Queue of output chunks replacing outMutex, or nullptr (see JobConfig::outputQueue)
+	std::unique_ptr<OutputQueue> outputQueue;
+	std::mutex drainMutex; // Makes sure the output queue has a single consumer at a time
+
 	std::vector<bool> joined; // Vector to track if threads have joined
 	std::mutex joinMutex; // Mutex for joining threads
 
+	// The pool of the job's intermediate segments, if the job keeps them between runs
+	std::unique_ptr<SegmentPool> segmentPool;
+
 	// Thread-safe intermediate data per thread
-	std::vector<IntermediateVec> intermediateVecs;
+	std::vector<SegmentedBuffer> intermediateVecs;
 
 	// Shuffled intermediate data: key → list of values
+	// Only the first shuffleCounter groups belong to the current run. The groups after them are
+	// left over from previous runs, and are only kept for their capacity.
 	std::vector<IntermediateVec> shuffledData;
 
+	// The client as an AggregatingClient, or nullptr if its reduce is not a built-in aggregation
+	const AggregatingClient* aggregator;
+
+	// The client as an AsyncMapReduceClient, or nullptr if its map cannot suspend
+	const AsyncMapReduceClient* asyncClient;
+	const int asyncTasksPerWorker; // Most map tasks in flight on a single worker
+	const int asyncIoThreads; // Threads of ioExecutor
+	std::unique_ptr<IoExecutor> ioExecutor; // Runs the blocking calls, created for the first async run
+
+	// The bytes accounted for every intermediate pair: the pair itself and the client's size hint
+	size_t pairBytes;
+
+	// The memory budget of the job, or nullptr if its memory is only tracked
+	std::unique_ptr<MemoryBudget> ownBudget; // Set if the job has a budget of its own
+	MemoryBudget* memoryBudget;
+	const std::chrono::milliseconds memoryWait; // How long a charge may wait for room
+	std::atomic<size_t> memoryUsed; // Bytes charged by this job
+	std::atomic<size_t> memoryReleased; // Bytes released in this run, given back in MEMORY_CHARGE_QUANTUM steps
+	std::atomic<size_t> memoryHighWater; // Most bytes charged by this job at once
+	std::atomic<bool> memoryBudgetExceeded; // Set when a charge did not fit, aborting the job
+
+	// The first error of the job (see getJobError)
+	std::atomic<bool> failed; // Set once an error is recorded, stopping the workers
+	std::mutex errorMutex; // Mutex for the error fields
+	std::exception_ptr error;
+	stage_t errorStage;
+	long errorTask;
+
+	// The workers wait until all of them were created, so they never wait at a barrier for a missing one
+	std::mutex launchMutex;
+	std::condition_variable launchCv;
+	int launchState; // LAUNCH_PENDING, LAUNCH_READY or LAUNCH_FAILED
+
+	// The scheduler sharing the host between jobs, or nullptr (see JobConfig::scheduler)
+	FairScheduler* scheduler;
+	const int schedulerJob; // The job's identifier in the scheduler
+
+	// Adaptive thread count (see JobConfig::adaptiveThreads)
+	const bool adaptiveThreads;
+	std::atomic<int> activeThreads; // Workers allowed to run tasks, the others wait at the gate
+	bool gateOpen; // Set when the phase ran out of tasks, releasing every waiting worker
+	std::mutex gateMutex; // Mutex for activeThreads changes and gateOpen
+	std::condition_variable gateCv; // Signalled when activeThreads grows or the gate opens
+	Adaptation adaptation; // The search for the best level in the current phase
+	std::atomic<int> mapThreads; // The level the map phase ran at
+	std::atomic<int> reduceThreads; // The level the reduce phase ran at
+
+	// The workers that run each phase, the others skip it (see JobConfig::mapThreadLevel)
+	const int mapLevel;
+	const int reduceLevel;
+
+	// Speculative map execution (see JobConfig::speculativeMap)
+	const bool speculativeMap;
+	std::unique_ptr<std::atomic<uint8_t>[]> taskStates; // TASK_* bits per input pair
+	size_t taskStatesSize; // The number of elements of taskStates
+	std::unique_ptr<RunningTask[]> runningTasks; // The map call of every worker
+	std::atomic<uint32_t> committedTasks; // The number of input pairs whose output was kept
+	std::array<std::atomic<uint32_t>, DURATION_BUCKETS> taskDurations; // Histogram of map call durations
+	std::atomic<size_t> speculativeTasks; // Duplicate map calls run
+	std::atomic<size_t> speculativeWins; // Duplicate map calls whose output was kept
+
+	// Map failure handling (see JobConfig::catchMapExceptions)
+	const bool catchMapExceptions;
+	const int mapRetries; // Retries of a throwing map call before its pair fails
+	std::atomic<size_t> retriedMapCalls; // Map calls retried after throwing
+	std::vector<size_t> failedMapInputs; // The indices of the pairs whose map failed
+	std::mutex failedMutex; // Mutex for failedMapInputs
+
+	// Task profiling (see JobConfig::profileTasks)
+	std::vector<TaskProfile> taskProfiles; // The profile of every worker, or empty if not profiled
+
+	// Hardware performance counters (see JobConfig::perfCounters)
+	const bool perfCounters;
+	std::vector<std::array<PhaseCounters, PERF_PHASES>> workerCounters; // The counts of every worker
+	unsigned perfEvents; // The events every worker could count so far
+	std::mutex perfMutex; // Mutex for workerCounters and perfEvents
+
+	MetricsRegistry* const metrics; // The registry the job is registered with, or nullptr
+	std::atomic<size_t> pendingIoCalls; // Blocking calls submitted to the I/O threads and not done
+
+	// Progress estimation (see getJobProgress)
+	std::atomic<int> runningWorkers; // Workers of the current run which have not exited yet
+	std::atomic<int64_t> runEnd; // The time the last worker of the run exited, or 0
+	std::array<std::atomic<double>, 4> stageCosts; // Expected duration of every stage relative to the map's
+
+	// Deterministic execution (see JobConfig::deterministic)
+	const bool deterministic;
+	std::vector<OutputVec> workerOutputs; // The output of every worker, in the order it was emitted (or sorted)
+	std::atomic<uint64_t> outputDigest; // The digest of the run's output, once it is written
+
+	// Sorted output (see JobConfig::sortOutput)
+	const bool sortOutput;
+	std::vector<OutputVec> sortedOutputs; // A sorted copy of the output of every worker
+	std::vector<std::vector<size_t>> outputSplits; // Where every part of the merge starts in every sorted output
+	OutputVec mergedOutput; // The merged output, when it is published through the output queue
+	size_t mergeBase; // The size of the merge's target vector before the merge
+
+	// Aggregated intermediate data: key → aggregate of its values (used instead of shuffledData)
+	std::vector<std::pair<K2*, Aggregate>> aggregatedData;
+
+	// Whether the shuffle and reduce phases are fused (see JobConfig::streamingReduce)
+	const bool streamingReduce;
+
+	// The key ranges of the sorted intermediate vectors, claimed by the workers in streaming mode
+	std::vector<KeyRange> keyRanges;
+
 	// A counter for the shuffled data. After the shuffle phase, this counter will represent
 	// the number of intermediate vectors in the shuffled data.
 	std::atomic<uint64_t> shuffleCounter;
@@ -49,10 +258,211 @@ struct JobContext {
 	std::atomic<uint32_t> nextInputIndex;  // For dynamic map scheduling
 	std::atomic<uint32_t> nextReduceIndex; // For dynamic reduce scheduling
 
-	JobContext(const InputVec& input, OutputVec& output, const int nThreads)
-		: stateManager(input.size()), barrier(std::make_unique<Barrier>(nThreads)), inputVec(input),
-		  outputVec(output), joined(nThreads, false), intermediateVecs(nThreads), shuffleCounter(0),
-		  nextInputIndex(0), nextReduceIndex(0) {}
+	JobContext(const JobConfig& config, const bool reusable)
+		: stateManager(0), barrier(std::make_unique<Barrier>(config.multiThreadLevel)),
+		  inputVec(nullptr), outputVec(nullptr), broadcast(nullptr),
+		  outputQueue(config.outputQueue ? std::make_unique<OutputQueue>() : nullptr),
+		  joined(config.multiThreadLevel, false),
+		  segmentPool(reusable ? std::make_unique<SegmentPool>(SIZE_MAX) : nullptr),
+		  aggregator(nullptr), asyncClient(nullptr),
+		  asyncTasksPerWorker(config.deterministic ? 1 : config.asyncTasksPerWorker),
+		  asyncIoThreads(config.asyncIoThreads), pairBytes(sizeof(IntermediatePair)),
+		  ownBudget(config.memoryBudget == nullptr && config.memoryBudgetBytes > 0
+		            ? std::make_unique<MemoryBudget>(config.memoryBudgetBytes) : nullptr),
+		  memoryBudget(config.memoryBudget != nullptr ? config.memoryBudget : ownBudget.get()),
+		  // Only the job itself could make room in a budget of its own, so its charges never wait
+		  memoryWait(ownBudget != nullptr ? 0 : config.memoryWaitMs), memoryUsed(0), memoryReleased(0),
+		  memoryHighWater(0),
+		  memoryBudgetExceeded(false), failed(false), errorStage(UNDEFINED_STAGE), errorTask(NO_TASK_INDEX),
+		  launchState(LAUNCH_PENDING), scheduler(config.scheduler),
+		  schedulerJob(scheduler != nullptr ? scheduler->addJob(config.priority, config.weight) : 0),
+		  adaptiveThreads(config.adaptiveThreads && !config.deterministic), activeThreads(config.multiThreadLevel),
+		  gateOpen(true), adaptation(), mapThreads(phaseLevel(config, config.mapThreadLevel)),
+		  reduceThreads(phaseLevel(config, config.reduceThreadLevel)),
+		  mapLevel(mapThreads.load(std::memory_order_relaxed)),
+		  reduceLevel(reduceThreads.load(std::memory_order_relaxed)), speculativeMap(config.speculativeMap && !config.deterministic),
+		  taskStatesSize(0), committedTasks(0), taskDurations(), speculativeTasks(0), speculativeWins(0),
+		  catchMapExceptions(config.catchMapExceptions), mapRetries(config.mapRetries), retriedMapCalls(0),
+		  perfCounters(config.perfCounters), workerCounters(config.multiThreadLevel), perfEvents(0),
+		  metrics(config.metrics), pendingIoCalls(0), runningWorkers(0), runEnd(0),
+		  deterministic(config.deterministic),
+		  workerOutputs(deterministic || config.sortOutput ? config.multiThreadLevel : 0), outputDigest(0),
+		  sortOutput(config.sortOutput), sortedOutputs(sortOutput ? config.multiThreadLevel : 0), mergeBase(0),
+		  streamingReduce(config.streamingReduce), shuffleCounter(0),
+		  nextInputIndex(0), nextReduceIndex(0) {
+		SegmentPool* pool = segmentPool != nullptr ? segmentPool.get() : &SegmentPool::instance();
+		intermediateVecs.reserve(config.multiThreadLevel);
+		for (int i = 0; i < config.multiThreadLevel; ++i) {
+			intermediateVecs.emplace_back(pool);
+		}
+		if (speculativeMap) {
+			runningTasks = std::make_unique<RunningTask[]>(config.multiThreadLevel);
+		}
+		if (config.profileTasks) {
+			taskProfiles.assign(config.multiThreadLevel, TaskProfile(config.slowestTasks));
+			ticksToNanos(0); // Calibrate the tick counter now rather than during the first call
+		}
+		if (metrics != nullptr) {
+			metrics->addJob(this, config.metricsName); // Last, since scrapes may read the job right away
+		}
+	}
+
+	/**
+	 * Prepares the job for a new run, keeping the capacity of all its buffers.
+	 * Must only be called while no worker thread is running.
+	 * @param client The implementation of MapReduceClient for the run.
+	 * @param input The input vector of the run.
+	 * @param output The output vector of the run.
+	 */
+	void prepareRun(const MapReduceClient& client, const InputVec& input, OutputVec& output) {
+		inputVec = &input;
+		outputVec = &output;
+		aggregator = dynamic_cast<const AggregatingClient*>(&client);
+		asyncClient = dynamic_cast<const AsyncMapReduceClient*>(&client);
+		if (asyncClient != nullptr && ioExecutor == nullptr) {
+			ioExecutor = std::make_unique<IoExecutor>(asyncIoThreads);
+		}
+		pairBytes = sizeof(IntermediatePair) + client.intermediatePairBytes();
+		learnStageCosts();
+		stateManager.updateState(UNDEFINED_STAGE, 0, input.size());
+		runningWorkers.store(static_cast<int>(intermediateVecs.size()), std::memory_order_relaxed);
+		runEnd.store(0, std::memory_order_relaxed);
+		for (auto& workerOutput : workerOutputs) {
+			workerOutput.clear();
+		}
+		outputDigest.store(0, std::memory_order_relaxed);
+
+		threads.clear();
+		std::fill(joined.begin(), joined.end(), false);
+		for (auto& vec : intermediateVecs) {
+			vec.clear(); // Only holds pairs if the previous run was aborted
+		}
+		aggregatedData.clear();
+		keyRanges.clear();
+		barrier->resetWaits(); // The workers of the previous run were joined
+		shuffleCounter.store(0, std::memory_order_relaxed);
+		nextInputIndex.store(0, std::memory_order_relaxed);
+		nextReduceIndex.store(0, std::memory_order_relaxed);
+
+		// The previous output belongs to the caller now, so it no longer counts against the budget
+		if (memoryBudget != nullptr) {
+			memoryBudget->release(memoryUsed.load(std::memory_order_relaxed));
+		}
+		memoryUsed.store(0, std::memory_order_relaxed);
+		memoryReleased.store(0, std::memory_order_relaxed);
+		memoryHighWater.store(0, std::memory_order_relaxed);
+		memoryBudgetExceeded.store(false, std::memory_order_relaxed);
+		failed.store(false, std::memory_order_relaxed);
+		{
+			// A monitoring thread may be reading the error and the counters of the previous run
+			std::lock_guard<std::mutex> errorLock(errorMutex);
+			error = nullptr;
+			errorStage = UNDEFINED_STAGE;
+			errorTask = NO_TASK_INDEX;
+		}
+		launchState = LAUNCH_PENDING;
+		resetGate(mapLevel);
+		for (auto& profile : taskProfiles) {
+			profile.clear();
+		}
+		{
+			std::lock_guard<std::mutex> perfLock(perfMutex);
+			std::fill(workerCounters.begin(), workerCounters.end(), std::array<PhaseCounters, PERF_PHASES>{});
+			perfEvents = perfCounters ? PERF_ALL_EVENTS : 0;
+		}
+
+		if (speculativeMap) {
+			if (taskStatesSize < input.size()) {
+				taskStates = std::make_unique<std::atomic<uint8_t>[]>(input.size());
+				taskStatesSize = input.size();
+			}
+			for (size_t i = 0; i < input.size(); ++i) {
+				taskStates[i].store(0, std::memory_order_relaxed);
+			}
+			for (size_t i = 0; i < intermediateVecs.size(); ++i) {
+				runningTasks[i].index.store(NO_TASK, std::memory_order_relaxed);
+			}
+			for (auto& bucket : taskDurations) {
+				bucket.store(0, std::memory_order_relaxed);
+			}
+			committedTasks.store(0, std::memory_order_relaxed);
+			speculativeTasks.store(0, std::memory_order_relaxed);
+			speculativeWins.store(0, std::memory_order_relaxed);
+		}
+		retriedMapCalls.store(0, std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> lock(failedMutex); // The list may be read by a metrics scrape
+			failedMapInputs.clear();
+		}
+	}
+
+	/**
+	 * Gets the number of workers that run a phase.
+	 * @param config The configuration of the job.
+	 * @param level The phase's level in the configuration, or 0 for all the workers.
+	 * @return The level, between 1 and the number of workers.
+	 */
+	static int phaseLevel(const JobConfig& config, const int level) {
+		return level <= 0 ? config.multiThreadLevel : std::min(level, config.multiThreadLevel);
+	}
+
+	/**
+	 * Closes the gate for a new phase in adaptive mode, leaving a few active workers.
+	 * Must only be called while no worker is running a phase, i.e. before the run or by thread 0
+	 * between barriers.
+	 * @param maxLevel The number of workers that run the phase.
+	 */
+	void resetGate(const int maxLevel) {
+		if (!adaptiveThreads) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(gateMutex);
+		const int level = std::min(ADAPTIVE_INITIAL_THREADS, maxLevel);
+		activeThreads.store(level, std::memory_order_relaxed);
+		gateOpen = false;
+		adaptation = Adaptation{std::chrono::steady_clock::now(), 0, 0, level, false, maxLevel};
+	}
+
+	/**
+	 * Sets the expected cost of the shuffle and reduce stages from the previous run, if it ran to
+	 * completion, or to the defaults otherwise. Must be called before a new run resets the
+	 * stage times.
+	 */
+	void learnStageCosts() {
+		const int64_t mapStart = stateManager.getStageStart(MAP_STAGE);
+		const int64_t shuffleStart = stateManager.getStageStart(SHUFFLE_STAGE);
+		const int64_t reduceStart = stateManager.getStageStart(REDUCE_STAGE);
+		const int64_t end = runEnd.load(std::memory_order_relaxed);
+		bool failedRun;
+		{
+			std::lock_guard<std::mutex> lock(errorMutex);
+			failedRun = error != nullptr;
+		}
+		if (mapStart != 0 && shuffleStart > mapStart && reduceStart >= shuffleStart && end >= reduceStart &&
+		    !failedRun && !memoryBudgetExceeded.load(std::memory_order_relaxed)) {
+			const auto mapTime = static_cast<double>(shuffleStart - mapStart);
+			stageCosts[SHUFFLE_STAGE].store(static_cast<double>(reduceStart - shuffleStart) / mapTime,
+			                                std::memory_order_relaxed);
+			stageCosts[REDUCE_STAGE].store(static_cast<double>(end - reduceStart) / mapTime,
+			                               std::memory_order_relaxed);
+		} else if (stageCosts[REDUCE_STAGE].load(std::memory_order_relaxed) == 0) {
+			stageCosts[SHUFFLE_STAGE].store(DEFAULT_SHUFFLE_COST, std::memory_order_relaxed); // The first run
+			stageCosts[REDUCE_STAGE].store(DEFAULT_REDUCE_COST, std::memory_order_relaxed);
+		}
+	}
+
+	~JobContext() {
+		if (metrics != nullptr) {
+			metrics->removeJob(this); // First, so no scrape reads the job while it is destroyed
+		}
+		// The output stays with the caller, but the job no longer counts against the budget
+		if (memoryBudget != nullptr) {
+			memoryBudget->release(memoryUsed.load(std::memory_order_relaxed));
+		}
+		if (scheduler != nullptr) {
+			scheduler->removeJob(schedulerJob);
+		}
+	}
 };
 
 /**
@@ -62,46 +472,737 @@ struct JobContext {
 struct ThreadContext {
 	int threadId;
 	JobContext* context;
-	std::vector<IntermediatePair>* intermediateVec; // Thread-local intermediate data
+	SegmentedBuffer* intermediateVec; // Thread-local intermediate data
+	OutputChunk* outputChunk; // The chunk the thread is filling, when the output queue is used
+	size_t usedBytes; // Bytes the thread has added to the job's memory usage
+	size_t chargedBytes; // Bytes the thread has charged for, in MEMORY_CHARGE_QUANTUM steps
+	size_t reservedSlots; // Empty slots the thread reserved in its intermediate vector, charged ahead of their pairs
+	CompletionQueue* completions; // The thread's resumable map tasks, or nullptr if tasks cannot suspend
+	bool holdsSlot; // Whether the thread holds a slot of the job's scheduler
+	int batchTasks; // Tasks the thread has run in its current slot
+	IntermediateVec* staging; // The emits of the current map call, or nullptr if emit2 adds them directly
+	long currentTask; // The task the thread is running, reported if it throws, or NO_TASK_INDEX
+	TaskProfile* profile; // The thread's profile, or nullptr if the job is not profiled
+	OutputVec* ownOutput; // The thread's output in deterministic or sorted mode, or nullptr if emit3 adds it directly
+	// The groups (or key ranges) the thread claimed, for deterministic mode. Kept across the re-entries
+	// of the reduce phase after a task threw, so that no claimed task is handed out twice
+	uint32_t reduceClaimed;
 };
 
+/**
+ * This function runs a call of the client's map or reduce, and records its duration in the
+ * thread's profile if the job is profiled. A call that throws is not recorded.
+ * @param tc The thread context.
+ * @param stage MAP_STAGE or REDUCE_STAGE.
+ * @param index The index of the input pair, group or key range the call processes.
+ * @param call The call to run.
+ */
+template <typename Call>
+void profiledCall(ThreadContext* tc, const stage_t stage, const size_t index, Call&& call) {
+	if (tc->profile == nullptr) {
+		call();
+		return;
+	}
+	const uint64_t start = readTicks();
+	call();
+	tc->profile->record(stage, index, ticksToNanos(readTicks() - start));
+}
+
+/**
+ * This function ends the measurement of a phase, adding its counts to the worker's counters.
+ * @param tc The thread context.
+ * @param perf The thread's performance counters, started at the beginning of the phase.
+ * @param phase The phase that ended.
+ */
+void stopCounting(ThreadContext* tc, PerfCounters& perf, const perf_phase_t phase) {
+	if (!perf.enabled()) {
+		return;
+	}
+	PhaseCounters counts{};
+	perf.stop(counts);
+	std::lock_guard<std::mutex> lock(tc->context->perfMutex);
+	PhaseCounters& counters = tc->context->workerCounters[tc->threadId][phase];
+	counters.nanos += counts.nanos;
+	counters.cycles += counts.cycles;
+	counters.instructions += counts.instructions;
+	counters.cacheMisses += counts.cacheMisses;
+	counters.branchMisses += counts.branchMisses;
+}
+
+/**
+ * This function claims the next task of a phase. The workers claim the tasks in the order they
+ * ask for them, unless the job is deterministic, in which case every worker runs a fixed,
+ * contiguous share of the tasks, in order.
+ * @param tc The thread context.
+ * @param next The phase's counter of claimed tasks.
+ * @param count The number of tasks in the phase.
+ * @param claimed The number of tasks this worker claimed in the phase, incremented if one is claimed.
+ * @param level The number of workers that run the phase.
+ * @return The index of the claimed task, or at least count if no task is left.
+ */
+uint32_t claimTask(const ThreadContext* tc, std::atomic<uint32_t>& next, const size_t count, uint32_t& claimed,
+                   const int level) {
+	// The shared counter is advanced in both modes, since the metrics and estimates read it
+	const uint32_t index = next.fetch_add(1, std::memory_order_relaxed);
+	if (!tc->context->deterministic) {
+		claimed += index < count;
+		return index;
+	}
+	const auto workers = static_cast<size_t>(level);
+	const size_t end = count * (tc->threadId + 1) / workers;
+	const size_t own = count * tc->threadId / workers + claimed;
+	if (own >= end) {
+		return static_cast<uint32_t>(count);
+	}
+	++claimed;
+	return static_cast<uint32_t>(own);
+}
+
+/**
+ * This function records an error of the job. Only the first error is kept, but every error
+ * stops the workers.
+ * @param context The job context.
+ * @param stage The stage in which the error occurred.
+ * @param task The task that was running, or NO_TASK_INDEX.
+ * @param exception The exception that was thrown.
+ */
+void recordError(JobContext* context, const stage_t stage, const long task, const std::exception_ptr& exception) {
+	std::lock_guard<std::mutex> lock(context->errorMutex);
+	if (context->error == nullptr) {
+		context->error = exception;
+		context->errorStage = stage;
+		context->errorTask = task;
+	}
+	context->failed.store(true, std::memory_order_relaxed);
+}
+
+/**
+ * This function checks whether the workers should stop taking new tasks, since the job failed
+ * or ran out of its memory budget.
+ * @param context The job context.
+ * @return true if the job is being aborted.
+ */
+bool isAborting(const JobContext* context) {
+	return context->failed.load(std::memory_order_relaxed) ||
+	       context->memoryBudgetExceeded.load(std::memory_order_relaxed);
+}
+
+/**
+ * This function gives the thread's scheduler slot back, if it holds one.
+ * Threads must not hold a slot while they wait for other threads, e.g. at a barrier.
+ * @param tc The thread context.
+ */
+void yieldSlot(ThreadContext *tc) {
+	if (tc->holdsSlot) {
+		tc->context->scheduler->release(tc->context->schedulerJob);
+		tc->holdsSlot = false;
+		tc->batchTasks = 0;
+	}
+}
+
+/**
+ * This function makes sure the thread holds a slot of the job's scheduler before it runs a task
+ * (a map call, a group, a key range). Does nothing if the job has no scheduler.
+ * @param tc The thread context.
+ */
+void beginTask(ThreadContext *tc) {
+	if (tc->context->scheduler != nullptr && !tc->holdsSlot) {
+		tc->context->scheduler->acquire(tc->context->schedulerJob);
+		tc->holdsSlot = true;
+	}
+}
+
+/**
+ * This function counts a task run in the thread's slot, giving the slot back once the batch is full,
+ * so that the other jobs get their turn.
+ * @param tc The thread context.
+ */
+void endTask(ThreadContext *tc) {
+	if (tc->holdsSlot && ++tc->batchTasks == SCHEDULER_BATCH_TASKS) {
+		yieldSlot(tc);
+	}
+}
+
+/**
+ * This function sets the number of active workers, waking up the workers that became active.
+ * Does nothing once the gate is open, as the phase is over by then.
+ * @param context The job context.
+ * @param level The new number of active workers.
+ */
+void setActiveThreads(JobContext* context, const int level) {
+	std::lock_guard<std::mutex> lock(context->gateMutex);
+	if (context->gateOpen) {
+		return;
+	}
+	context->activeThreads.store(level, std::memory_order_relaxed);
+	context->gateCv.notify_all();
+}
+
+/**
+ * This function samples the throughput of the current phase, and searches for the best number
+ * of active workers: the level is doubled as long as the throughput grows by at least
+ * ADAPT_MIN_GAIN, and once it does not, the level goes back to the best one and stays there.
+ * Called by thread 0 between its tasks.
+ * @param context The job context.
+ */
+void adaptThreads(JobContext* context) {
+	Adaptation& adaptation = context->adaptation;
+	const auto now = std::chrono::steady_clock::now();
+	if (adaptation.settled || now - adaptation.sampleTime < ADAPT_INTERVAL) {
+		return;
+	}
+	stage_t stage;
+	uint32_t processed;
+	uint32_t total;
+	context->stateManager.getState(stage, processed, total);
+	if (processed == adaptation.sampleProcessed) {
+		return; // Nothing finished yet (e.g. the workers are still starting), so keep sampling
+	}
+	const double seconds = std::chrono::duration<double>(now - adaptation.sampleTime).count();
+	const double throughput = static_cast<double>(processed - adaptation.sampleProcessed) / seconds;
+	adaptation.sampleTime = now;
+	adaptation.sampleProcessed = processed;
+
+	const int level = context->activeThreads.load(std::memory_order_relaxed);
+	const int maxLevel = adaptation.maxLevel;
+	if (throughput >= adaptation.bestThroughput * ADAPT_MIN_GAIN) {
+		adaptation.bestThroughput = throughput;
+		adaptation.bestLevel = level;
+		if (level < maxLevel) {
+			setActiveThreads(context, std::min(level * 2, maxLevel));
+			return;
+		}
+	}
+	// Adding workers stopped helping (or there are no more), so settle on the best level
+	adaptation.settled = true;
+	if (adaptation.bestLevel < level) {
+		setActiveThreads(context, adaptation.bestLevel);
+	}
+}
+
+/**
+ * This function holds the thread back while it is not one of the active workers of the phase
+ * (see JobConfig::adaptiveThreads). Thread 0 is always active, and adapts the level instead.
+ * Called by the workers before claiming a map or reduce task.
+ * @param tc The thread context.
+ */
+void passGate(ThreadContext *tc) {
+	JobContext* context = tc->context;
+	if (!context->adaptiveThreads) {
+		return;
+	}
+	if (tc->threadId == THREAD_ZERO) {
+		adaptThreads(context);
+		return;
+	}
+	if (tc->threadId < context->activeThreads.load(std::memory_order_relaxed)) {
+		return;
+	}
+	yieldSlot(tc); // A waiting worker does not hold a scheduler slot
+	std::unique_lock<std::mutex> lock(context->gateMutex);
+	context->gateCv.wait(lock, [tc, context] {
+		return tc->threadId < context->activeThreads.load(std::memory_order_relaxed);
+	});
+}
+
+/**
+ * This function opens the gate once a phase ran out of tasks, so the waiting workers find out
+ * there is nothing left and move on. The level the phase ran at is recorded for the stats.
+ * @param context The job context.
+ * @param chosenLevel Where to record the level of the phase.
+ */
+void openGate(JobContext* context, std::atomic<int>& chosenLevel) {
+	if (!context->adaptiveThreads) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(context->gateMutex);
+	if (context->gateOpen) {
+		return; // Already opened by another worker
+	}
+	context->gateOpen = true;
+	chosenLevel.store(context->activeThreads.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	context->activeThreads.store(static_cast<int>(context->intermediateVecs.size()), std::memory_order_relaxed);
+	context->gateCv.notify_all();
+}
+
+/**
+ * This function charges the given number of bytes to the job's memory usage and budget.
+ * The bytes are charged even if they do not fit, since the memory they stand for is already in
+ * use, so that the job's usage always covers the bytes it releases later.
+ * @param context The job context.
+ * @param bytes The number of bytes to charge.
+ * @param enforce If true, the job is aborted if the bytes do not fit in the budget in time.
+ *                Otherwise, the bytes are charged even if they exceed the budget.
+ * @return true if the bytes fit in the budget (or were not enforced), false otherwise.
+ */
+bool chargeMemory(JobContext* context, const size_t bytes, const bool enforce) {
+	bool fits = true;
+	if (context->memoryBudget != nullptr) {
+		// Once the job is aborting, there is no point in waiting for room
+		if (!enforce || context->memoryBudgetExceeded.load(std::memory_order_relaxed) ||
+		    !context->memoryBudget->tryCharge(bytes, context->memoryWait)) {
+			fits = !enforce;
+			context->memoryBudget->charge(bytes);
+		}
+	}
+	if (!fits) {
+		context->memoryBudgetExceeded.store(true, std::memory_order_relaxed);
+	}
+	const size_t used = context->memoryUsed.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	size_t highWater = context->memoryHighWater.load(std::memory_order_relaxed);
+	while (used > highWater && !context->memoryHighWater.compare_exchange_weak(
+			highWater, used, std::memory_order_relaxed)) {
+		// On failure, highWater is updated to the current value → retry
+	}
+	return fits;
+}
+
+/**
+ * This function releases the given number of bytes from the job's memory usage and budget.
+ * The bytes are given back in the same MEMORY_CHARGE_QUANTUM steps the threads charge them in,
+ * once enough of them were released in the run, so the charged bytes never fall below the
+ * bytes still in use.
+ * @param context The job context.
+ * @param bytes The number of bytes to release.
+ */
+void releaseMemory(JobContext* context, const size_t bytes) {
+	const size_t released = context->memoryReleased.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	const size_t steps = released / MEMORY_CHARGE_QUANTUM - (released - bytes) / MEMORY_CHARGE_QUANTUM;
+	if (steps == 0) {
+		return;
+	}
+	context->memoryUsed.fetch_sub(steps * MEMORY_CHARGE_QUANTUM, std::memory_order_relaxed);
+	if (context->memoryBudget != nullptr) {
+		context->memoryBudget->release(steps * MEMORY_CHARGE_QUANTUM);
+	}
+}
+
+/**
+ * This function adds bytes to the thread's memory usage. The thread charges the job in
+ * MEMORY_CHARGE_QUANTUM steps, so that the budget is not touched for every single pair.
+ * @param tc The thread context, which contains the thread's memory usage.
+ * @param bytes The number of bytes to add.
+ * @param enforce Whether the charge may fail (see chargeMemory).
+ */
+void accountMemory(ThreadContext *tc, const size_t bytes, const bool enforce) {
+	tc->usedBytes += bytes;
+	if (tc->usedBytes > tc->chargedBytes) {
+		const size_t quantum = std::max<size_t>(MEMORY_CHARGE_QUANTUM, tc->usedBytes - tc->chargedBytes);
+		chargeMemory(tc->context, quantum, enforce);
+		tc->chargedBytes += quantum;
+	}
+}
+
+/**
+ * This function reserves the thread's intermediate vector for the pairs it is expected to emit,
+ * assuming the remaining input pairs are split evenly between the threads that run the map phase.
+ * The reserved segments are charged right away, and the pairs later emitted into them only
+ * charge the client's part of their size.
+ * @param tc The thread context, containing the thread's intermediate vector.
+ * @param emitsPerInput The expected number of pairs emitted for a single input pair.
+ */
+void reserveIntermediate(ThreadContext *tc, const double emitsPerInput) {
+	const JobContext* context = tc->context;
+	const size_t inputSize = context->inputVec->size();
+	const size_t nextInput = std::min<size_t>(
+		context->nextInputIndex.load(std::memory_order_relaxed), inputSize
+	);
+	const double remainingShare = static_cast<double>(inputSize - nextInput) /
+	                              static_cast<double>(context->mapLevel);
+	const auto expected = static_cast<size_t>(emitsPerInput * remainingShare * RESERVE_SLACK);
+	const size_t capacity = tc->intermediateVec->capacity();
+	tc->intermediateVec->reserve(tc->intermediateVec->size() + expected);
+	const size_t reserved = tc->intermediateVec->capacity() - capacity;
+	tc->reservedSlots += reserved;
+	accountMemory(tc, reserved * sizeof(IntermediatePair), true);
+}
+
+/**
+ * This function releases the charge of the slots the thread reserved but did not fill, once the
+ * map phase is over.
+ * @param tc The thread context.
+ */
+void releaseReservedSlots(ThreadContext *tc) {
+	const size_t bytes = tc->reservedSlots * sizeof(IntermediatePair);
+	tc->reservedSlots = 0;
+	tc->usedBytes -= bytes;
+	tc->chargedBytes -= bytes; // The thread's headroom stays as it was
+	releaseMemory(tc->context, bytes);
+}
+
+/**
+ * This function is the map phase for an AsyncMapReduceClient.
+ * The thread starts up to asyncTasksPerWorker map tasks. Whenever a task awaits a blocking call,
+ * the thread starts another one, and once it cannot start more it resumes the tasks whose calls
+ * have returned. Every task is only ever resumed by the thread that started it.
+ * @param tc The thread context, which contains the thread ID and the job context.
+ * @param emitsPerInput The client's fan-out hint, or 0 to estimate it (see mapPhase).
+ */
+void asyncMapPhase(ThreadContext *tc, const double emitsPerInput) {
+	JobContext* context = tc->context;
+	CompletionQueue completions; // Outlives every task, since the thread waits for all of them
+	tc->completions = &completions;
+	int inFlight = 0;
+	bool inputLeft = true;
+	uint32_t mappedByThread = 0;
+	uint32_t claimed = 0; // The input pairs this thread claimed, for deterministic mode
+
+	// Runs the task until it awaits a blocking call or finishes
+	const auto step = [&](const std::coroutine_handle<MapTask::promise_type> task) {
+		beginTask(tc);
+		task.resume();
+		endTask(tc);
+		if (!task.done()) {
+			return; // The task will be pushed to the completion queue once its call returns
+		}
+		const std::exception_ptr exception = task.promise().exception;
+		const uint32_t index = task.promise().inputIndex;
+		task.destroy();
+		--inFlight;
+		if (exception) {
+			// The other tasks still have to be waited for, so the error is recorded right here
+			recordError(context, MAP_STAGE, index, exception);
+			return;
+		}
+		context->stateManager.incrementProcessed();
+		if (++mappedByThread == FANOUT_SAMPLE_INPUTS && emitsPerInput <= 0) {
+			reserveIntermediate(tc, static_cast<double>(tc->intermediateVec->size()) / mappedByThread);
+		}
+	};
+
+	while (true) {
+		// Start new tasks while there is room for them
+		while (inputLeft && inFlight < context->asyncTasksPerWorker) {
+			if (isAborting(context)) {
+				inputLeft = false; // The job is being aborted, only the started tasks are finished
+				break;
+			}
+			const uint32_t oldValue = claimTask(tc, context->nextInputIndex, context->inputVec->size(), claimed,
+			                                    context->mapLevel);
+			if (oldValue >= context->inputVec->size()) {
+				inputLeft = false; // All input pairs have been claimed
+				break;
+			}
+			const auto&[fst, snd] = (*context->inputVec)[oldValue];
+			std::coroutine_handle<MapTask::promise_type> task;
+			try {
+				task = context->asyncClient->mapAsync(fst, snd, tc).release();
+			} catch (...) {
+				recordError(context, MAP_STAGE, oldValue, std::current_exception());
+				continue;
+			}
+			task.promise().inputIndex = oldValue;
+			++inFlight;
+			step(task);
+		}
+
+		if (inFlight == 0) {
+			break; // All the tasks of this thread are done
+		}
+		yieldSlot(tc); // The slot is not held while waiting
+		step(completions.pop()); // Wait for a blocking call to return, and resume its task
+	}
+	yieldSlot(tc);
+	tc->completions = nullptr;
+}
+
+bool BlockingCall::await_ready() {
+	if (static_cast<const ThreadContext*>(context)->completions != nullptr) {
+		return false; // Suspend, and run the call on the I/O threads
+	}
+	try {
+		call();
+	} catch (...) {
+		exception = std::current_exception();
+	}
+	return true;
+}
+
+void BlockingCall::await_suspend(const std::coroutine_handle<> handle) {
+	const auto *tc = static_cast<const ThreadContext*>(context);
+	CompletionQueue* completions = tc->completions;
+	// BlockingCall is only awaited directly by mapAsync, so the suspended coroutine is a MapTask
+	const auto task = std::coroutine_handle<MapTask::promise_type>::from_address(handle.address());
+	JobContext* job = tc->context;
+	job->pendingIoCalls.fetch_add(1, std::memory_order_relaxed);
+	job->ioExecutor->submit([this, completions, task, job] {
+		try {
+			call();
+		} catch (...) {
+			exception = std::current_exception();
+		}
+		job->pendingIoCalls.fetch_sub(1, std::memory_order_relaxed);
+		// The task may be resumed and destroyed right away, so this object is not touched anymore
+		completions->push(task);
+	});
+}
+
+/**
+ * This function returns the current time for the speculative mode's bookkeeping.
+ * @return The steady_clock time, in nanoseconds.
+ */
+int64_t nowNanos() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * This function estimates the median duration of the map calls that have returned so far,
+ * from their histogram.
+ * @param context The job context.
+ * @return The upper bound of the median's bucket in nanoseconds, or 0 if no call has returned yet.
+ */
+int64_t medianTaskNanos(const JobContext* context) {
+	uint64_t count = 0;
+	for (const auto& bucket : context->taskDurations) {
+		count += bucket.load(std::memory_order_relaxed);
+	}
+	if (count == 0) {
+		return 0;
+	}
+	uint64_t seen = 0;
+	for (int i = 0; i < DURATION_BUCKETS; ++i) {
+		seen += context->taskDurations[i].load(std::memory_order_relaxed);
+		if (2 * seen >= count) {
+			return i + 1 < DURATION_BUCKETS ? int64_t{1} << (i + 1) : INT64_MAX;
+		}
+	}
+	return INT64_MAX;
+}
+
+/**
+ * This function hands the staged pairs of the thread's current map call back to the client.
+ * @param client The implementation of MapReduceClient, where releaseIntermediate is defined.
+ * @param tc The thread context, containing the staged pairs.
+ */
+void discardStaged(const MapReduceClient& client, ThreadContext *tc) {
+	IntermediateVec& staged = *tc->staging;
+	for (const auto& [key, value] : staged) {
+		client.releaseIntermediate(key, value);
+	}
+	tc->usedBytes -= staged.size() * tc->context->pairBytes;
+	staged.clear();
+}
+
+/**
+ * This function runs the map of a single input pair. In speculative mode, or when map exceptions
+ * are caught, the emits of the call are staged and only committed to the thread's intermediate
+ * vector once the call returned, and only if no other run of the same pair was committed first.
+ * Otherwise, they are handed back to the client.
+ * @param client The implementation of MapReduceClient, where the map function is defined.
+ * @param tc The thread context, which contains the thread ID and the job context.
+ * @param index The index of the input pair.
+ * @return true if the output of this run was kept, false if it was a duplicate or the pair failed.
+ */
+bool runMapTask(const MapReduceClient& client, ThreadContext *tc, const uint32_t index) {
+	JobContext* context = tc->context;
+	// No need to synchronize access to inputVec, since it is only read
+	const auto&[fst, snd] = (*context->inputVec)[index];
+	tc->currentTask = index;
+	if (tc->staging == nullptr) {
+		profiledCall(tc, MAP_STAGE, index, [&] { client.map(fst, snd, tc); });
+		// Since we have mapped (processed) a pair,
+		// increment the processed count in the job context. This is done atomically.
+		context->stateManager.incrementProcessed();
+		return true;
+	}
+
+	RunningTask* running = context->speculativeMap ? &context->runningTasks[tc->threadId] : nullptr;
+	bool failed = false;
+	for (int attempt = 0; ; ++attempt) {
+		const int64_t start = running != nullptr ? nowNanos() : 0;
+		if (running != nullptr) {
+			// The index is released after the start time, so whoever reads it sees this call's start
+			running->since.store(start, std::memory_order_relaxed);
+			running->index.store(index, std::memory_order_release);
+		}
+		try {
+			profiledCall(tc, MAP_STAGE, index, [&] { client.map(fst, snd, tc); });
+		} catch (...) {
+			if (running != nullptr) {
+				running->index.store(NO_TASK, std::memory_order_relaxed);
+			}
+			discardStaged(client, tc); // The partial output of the call is never committed
+			if (!context->catchMapExceptions) {
+				throw;
+			}
+			if (attempt < context->mapRetries) {
+				context->retriedMapCalls.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+			failed = true;
+			break;
+		}
+		if (running != nullptr) {
+			running->index.store(NO_TASK, std::memory_order_relaxed);
+			const auto duration = static_cast<uint64_t>(std::max<int64_t>(nowNanos() - start, 1));
+			const int bucket = std::min(63 - __builtin_clzll(duration), DURATION_BUCKETS - 1);
+			context->taskDurations[bucket].fetch_add(1, std::memory_order_relaxed);
+		}
+		break;
+	}
+
+	// In speculative mode, the first run to finish (or to fail for good) decides the pair's output
+	if (context->speculativeMap &&
+	    (context->taskStates[index].fetch_or(TASK_COMMITTED, std::memory_order_acq_rel) & TASK_COMMITTED) != 0) {
+		discardStaged(client, tc); // The other run already finished, so this run's output is a duplicate
+		return false;
+	}
+	if (failed) {
+		std::lock_guard<std::mutex> lock(context->failedMutex);
+		context->failedMapInputs.push_back(index);
+	} else {
+		for (const auto& pair : *tc->staging) {
+			tc->intermediateVec->emplace_back(pair.first, pair.second);
+		}
+		tc->staging->clear();
+	}
+	context->committedTasks.fetch_add(1, std::memory_order_relaxed);
+	context->stateManager.incrementProcessed();
+	return !failed;
+}
+
+/**
+ * This function finds a map call which is running far longer than the median, and which was
+ * not duplicated yet.
+ * @param tc The context of an idle thread.
+ * @return The index of the call's input pair, claimed for a duplicate run, or NO_TASK.
+ */
+uint32_t findStraggler(const ThreadContext *tc) {
+	JobContext* context = tc->context;
+	const int64_t median = medianTaskNanos(context);
+	if (median == 0) {
+		return NO_TASK; // Nothing to compare with yet
+	}
+	const int64_t minAge = std::max<int64_t>(
+		median > INT64_MAX / SPECULATION_FACTOR ? INT64_MAX : median * SPECULATION_FACTOR,
+		std::chrono::duration_cast<std::chrono::nanoseconds>(SPECULATION_MIN_AGE).count()
+	);
+	const int64_t now = nowNanos();
+	for (size_t i = 0; i < context->intermediateVecs.size(); ++i) {
+		const RunningTask& running = context->runningTasks[i];
+		const uint32_t index = running.index.load(std::memory_order_acquire);
+		if (index == NO_TASK) {
+			continue;
+		}
+		const int64_t since = running.since.load(std::memory_order_acquire);
+		// If the worker moved on meanwhile, since may belong to its next call, so the slot is skipped
+		if (running.index.load(std::memory_order_relaxed) != index || now - since < minAge) {
+			continue;
+		}
+		// Only a single duplicate is run per task, by whoever sets the bit first
+		if (context->taskStates[index].fetch_or(TASK_SPECULATED, std::memory_order_relaxed) == 0) {
+			return index;
+		}
+	}
+	return NO_TASK;
+}
+
+/**
+ * This function keeps a thread which ran out of input pairs busy with duplicates of straggling
+ * map calls, until the output of every input pair was kept.
+ * @param client The implementation of MapReduceClient, where the map function is defined.
+ * @param tc The thread context, which contains the thread ID and the job context.
+ */
+void speculateStragglers(const MapReduceClient& client, ThreadContext *tc) {
+	JobContext* context = tc->context;
+	while (context->committedTasks.load(std::memory_order_relaxed) < context->inputVec->size() &&
+	       !isAborting(context)) {
+		const uint32_t index = findStraggler(tc);
+		if (index == NO_TASK) {
+			std::this_thread::sleep_for(SPECULATION_POLL);
+			continue;
+		}
+		context->speculativeTasks.fetch_add(1, std::memory_order_relaxed);
+		beginTask(tc);
+		if (runMapTask(client, tc, index)) {
+			context->speculativeWins.fetch_add(1, std::memory_order_relaxed);
+		}
+		endTask(tc);
+		yieldSlot(tc); // The slot is not held while looking for stragglers
+	}
+}
+
 /**
  * This function is the map phase of the MapReduce algorithm.
  * @param client The implementation of MapReduceClient, where the map function is defined.
  * @param tc The thread context, which contains the thread ID and the job context.
  */
 void mapPhase(const MapReduceClient& client, ThreadContext *tc) {
-	if (tc->threadId == THREAD_ZERO) {
-		// Set the job state to MAP_STAGE
-		// This is done only by thread 0, to avoid multiple calls to setStage (overhead)
-		tc->context->stateManager.setStage(MAP_STAGE);
+	// Set the job state to MAP_STAGE. Every thread tries, since the first one to map a pair must not
+	// count it in the UNDEFINED_STAGE, where the count would be reset; the others find it already set
+	tc->context->stateManager.advanceStage(UNDEFINED_STAGE, MAP_STAGE);
+	if (tc->threadId >= tc->context->mapLevel) {
+		return; // Not one of the phase's workers, so the thread waits for the next phase without a slot
 	}
+
+	// Without a hint from the client, the fan-out is estimated after the first few map calls
+	const double emitsPerInput = client.expectedEmitsPerInput();
+	if (emitsPerInput > 0) {
+		reserveIntermediate(tc, emitsPerInput);
+	}
+	if (tc->context->asyncClient != nullptr) {
+		asyncMapPhase(tc, emitsPerInput);
+		return;
+	}
+	IntermediateVec staged; // The emits of the current map call, if they may be discarded
+	if (tc->context->speculativeMap || tc->context->catchMapExceptions) {
+		tc->staging = &staged;
+	}
+	uint32_t mappedByThread = 0;
+
 	while (true) {
+		if (isAborting(tc->context)) {
+			break; // The job failed or ran out of memory, so there is no point in mapping any further
+		}
+		passGate(tc);
+		beginTask(tc);
+
 		// Atomically fetch and increment the next input index
-		const uint32_t oldValue = tc->context->nextInputIndex.fetch_add(1, std::memory_order_relaxed);
+		const uint32_t oldValue = claimTask(tc, tc->context->nextInputIndex, tc->context->inputVec->size(),
+		                                    mappedByThread, tc->context->mapLevel);
 
 		// Check if the index is within bounds
-		if (oldValue >= tc->context->inputVec.size()) {
+		if (oldValue >= tc->context->inputVec->size()) {
 			break; // All input pairs have been processed
 		}
 
 		// Safely process the input pair at the fetched index
-		// No need to synchronize access to inputVec,
-		// since only the current thread has the value of oldValue
-		const auto&[fst, snd] = tc->context->inputVec[oldValue];
-		client.map(fst, snd, tc);
-		// Since we have mapped (processed) a pair,
-		// increment the processed count in the job context. This is done atomically.
-		tc->context->stateManager.incrementProcessed();
+		// Only the current thread has the value of oldValue, unless the call straggles
+		runMapTask(client, tc, oldValue);
+
+		if (mappedByThread == FANOUT_SAMPLE_INPUTS && emitsPerInput <= 0) {
+			reserveIntermediate(tc, static_cast<double>(tc->intermediateVec->size()) / mappedByThread);
+		}
+		endTask(tc);
+	}
+	yieldSlot(tc);
+	openGate(tc->context, tc->context->mapThreads);
+
+	if (tc->context->speculativeMap) {
+		speculateStragglers(client, tc);
 	}
+	tc->staging = nullptr;
 }
 
 void emit2 (K2* key, V2* value, void* context) {
-	const auto *tc = static_cast<ThreadContext*>(context);
+	auto *tc = static_cast<ThreadContext*>(context);
 	// There is no need to synchronize access to intermediateVec,
 	// as each thread has its own intermediate vector
-	// Add the key-value pair to the thread's intermediate vector
-	tc->intermediateVec->emplace_back(key, value);
+	// Add the key-value pair to the thread's intermediate vector, or to the staged pairs of the
+	// current map call if it may be duplicated
+	size_t bytes = tc->context->pairBytes;
+	if (tc->staging != nullptr) {
+		tc->staging->emplace_back(key, value);
+	} else {
+		tc->intermediateVec->emplace_back(key, value);
+		if (tc->reservedSlots > 0) {
+			--tc->reservedSlots;
+			bytes -= sizeof(IntermediatePair); // The slot itself was charged when it was reserved
+		}
+	}
+	// The pair is kept even if it does not fit in the budget, since the client already created it
+	accountMemory(tc, bytes, true);
 }
 
 /**
@@ -109,14 +1210,50 @@ void emit2 (K2* key, V2* value, void* context) {
  * It sorts the thread's intermediate vector based on the keys.
  * @param tc The thread context, containing the thread's intermediate vector.
  */
-void sortPhase(const ThreadContext *tc) {
+void sortPhase(ThreadContext *tc) {
 	// There is no need to synchronize access to intermediateVec,
 	// as each thread has its own intermediate vector
-	// Sort the intermediate vector based on the keys
-	std::sort(tc->intermediateVec->begin(), tc->intermediateVec->end(),
-			[](const IntermediatePair& a, const IntermediatePair& b) {
-				return *a.first < *b.first;
-	});
+	// Sort the intermediate vector based on the keys, segment by segment and then merged
+	releaseReservedSlots(tc); // No more pairs are emitted into the vector
+	beginTask(tc);
+	tc->intermediateVec->sort();
+	yieldSlot(tc);
+}
+
+/**
+ * This function folds all the pairs with the given key into a single aggregate,
+ * instead of collecting them into a new sequence in the shuffled data.
+ * Every consumed pair is released, except for the group's key which is kept for the output.
+ * @param context The job context, whose client is an AggregatingClient.
+ * @param groupKey The key of the group, taken from the back of one of the intermediate vectors.
+ */
+void aggregateGroup(JobContext* context, K2* groupKey) {
+	Aggregate aggregate;
+	bool keyConsumed = false;
+	try {
+		for (auto& vec : context->intermediateVecs) {
+			while (!vec.empty() && vec.back().first->compare(*groupKey) == 0) {
+				const auto [key, value] = vec.back();
+				aggregate.add(static_cast<const NumericValue*>(value)->value);
+				vec.pop_back();
+				keyConsumed = keyConsumed || key == groupKey;
+				// groupKey itself is still needed for the comparisons, so it is never released here
+				context->aggregator->releaseIntermediate(key == groupKey ? nullptr : key, value);
+				context->stateManager.incrementProcessed();
+			}
+		}
+	} catch (...) {
+		if (keyConsumed) {
+			context->aggregator->releaseIntermediate(groupKey, nullptr); // The group is never emitted
+		}
+		releaseMemory(context, aggregate.count() * context->pairBytes);
+		throw;
+	}
+	context->aggregatedData.emplace_back(groupKey, aggregate);
+	// The folded pairs are gone, except for the group's key which is not accounted on its own
+	releaseMemory(context, aggregate.count() * context->pairBytes);
+	// Since we have added a new aggregate, we need to increment the shuffle counter
+	context->shuffleCounter.fetch_add(1, std::memory_order_relaxed);
 }
 
 /**
@@ -125,7 +1262,7 @@ void sortPhase(const ThreadContext *tc) {
  * elements with a given key are in a single sequence.
  * @param tc The context of thread 0, which is responsible for the shuffle phase.
  */
-void shufflePhase(const ThreadContext *tc) {
+void shufflePhase(ThreadContext *tc) {
 	JobContext* context = tc->context;
 
 	// Count the total number of intermediate pairs
@@ -137,13 +1274,14 @@ void shufflePhase(const ThreadContext *tc) {
 	// Reset the processed count and change the total since we are starting the shuffle phase
 	context->stateManager.setTotal(totalPairs);
 
-	while (true) {
-		const K2* maxKey = nullptr;
+	while (!isAborting(context)) {
+		beginTask(tc);
+		K2* maxKey = nullptr;
 
 		// Find max key at the back of any non-empty vector
 		for (const auto& vec : context->intermediateVecs) {
 			if (!vec.empty()) {
-				if (const K2* candidate = vec.back().first;
+				if (K2* candidate = vec.back().first;
 					maxKey == nullptr || *maxKey < *candidate) {
 					maxKey = candidate;
 				}
@@ -154,25 +1292,300 @@ void shufflePhase(const ThreadContext *tc) {
 			break; // All vectors empty
 		}
 
+		if (context->aggregator != nullptr) {
+			aggregateGroup(context, maxKey);
+			endTask(tc);
+			continue;
+		}
+
 		// Collect all pairs with maxKey
-		context->shuffledData.emplace_back(); // Create a new IntermediateVec
-		auto& currentGroup = context->shuffledData.back(); // Reference to the new vector
+		// Reuse a group left over from a previous run if there is one, for its capacity
+		const size_t groupIndex = context->shuffleCounter.load(std::memory_order_relaxed);
+		if (groupIndex == context->shuffledData.size()) {
+			context->shuffledData.emplace_back(); // Create a new IntermediateVec
+		}
+		auto& currentGroup = context->shuffledData[groupIndex]; // Reference to the group's vector
+		currentGroup.clear();
+		// The group is counted before it is filled, so if a comparison throws while filling it,
+		// the pairs already moved into it are released by the reduce phase
+		context->shuffleCounter.fetch_add(1, std::memory_order_relaxed);
+
+		for (auto& vec : context->intermediateVecs) {
+			while (!vec.empty() && vec.back().first->compare(*maxKey) == 0) {
+				// Move the pair from the intermediate vector to the shuffled data
+				currentGroup.emplace_back(vec.back().first, vec.back().second);
+				vec.pop_back(); // Remove the pair from the intermediate vector
+				context->stateManager.incrementProcessed(); // Increment the processed count
+			}
+		}
+		endTask(tc);
+	}
+	yieldSlot(tc);
+}
+
+/**
+ * This function finds the position of the first pair whose key is not less than the given key.
+ * @param vec A sorted intermediate vector.
+ * @param key The key to search for, or nullptr to get the end of the vector.
+ * @return The index of the first pair in vec whose key is not less than key.
+ */
+size_t lowerBound(const SegmentedBuffer& vec, const K2* key) {
+	if (key == nullptr) {
+		return vec.size();
+	}
+	// Binary search over [low, high), which always contains the first pair not less than key
+	size_t low = 0;
+	size_t high = vec.size();
+	while (low < high) {
+		if (const size_t mid = low + (high - low) / 2; *vec[mid].first < *key) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return low;
+}
+
+/**
+ * This function splits the sorted intermediate vectors into key ranges for the streaming mode,
+ * so that all the pairs of a given key fall in a single range.
+ * The range boundaries are chosen from keys sampled at a fixed stride over all the vectors,
+ * so the ranges hold roughly the same number of pairs.
+ * @param tc The context of thread 0, which is responsible for the partitioning.
+ * @return The total number of intermediate pairs.
+ */
+size_t partitionKeyRanges(ThreadContext *tc) {
+	JobContext* context = tc->context;
+	beginTask(tc);
+	const size_t numVecs = context->intermediateVecs.size();
+
+	size_t totalPairs = 0;
+	for (const auto& vec : context->intermediateVecs) {
+		totalPairs += vec.size();
+	}
+
+	// Sample the keys at a fixed stride, so that each sample stands for the same number of pairs
+	const size_t wantedRanges = numVecs * RANGES_PER_THREAD;
+	const size_t stride = std::max<size_t>(1, totalPairs / (wantedRanges * SAMPLES_PER_RANGE));
+	std::vector<const K2*> samples;
+	for (const auto& vec : context->intermediateVecs) {
+		for (size_t i = stride / 2; i < vec.size(); i += stride) {
+			samples.push_back(vec[i].first);
+		}
+	}
+	std::sort(samples.begin(), samples.end(), [](const K2* a, const K2* b) { return *a < *b; });
+
+	// Every SAMPLES_PER_RANGE-th sample becomes a boundary, skipping equal boundaries
+	std::vector<const K2*> boundaries;
+	for (size_t i = SAMPLES_PER_RANGE; i < samples.size(); i += SAMPLES_PER_RANGE) {
+		if (boundaries.empty() || *boundaries.back() < *samples[i]) {
+			boundaries.push_back(samples[i]);
+		}
+	}
+	boundaries.push_back(nullptr); // The last range is unbounded
+
+	// Each range starts where the previous one ended, at the first key not less than its boundary
+	std::vector<size_t> lower(numVecs, 0);
+	for (const K2* upperKey : boundaries) {
+		KeyRange range{lower, std::vector<size_t>(numVecs)};
+		for (size_t i = 0; i < numVecs; ++i) {
+			range.end[i] = lowerBound(context->intermediateVecs[i], upperKey);
+		}
+		lower = range.end;
+		context->keyRanges.push_back(std::move(range));
+	}
+	yieldSlot(tc);
+	return totalPairs;
+}
+
+/**
+ * This function folds the group of the smallest key left in a key range into a single aggregate,
+ * straight from the heads of the range in the sorted intermediate vectors, and emits it.
+ * Every consumed pair is released as soon as it is folded, except for the group's key, whose
+ * ownership passes to emitAggregate.
+ * @param tc The thread context, which contains the job context.
+ * @param heads The first pair of the range not consumed yet in every vector, advanced past the group.
+ * @param range The key range.
+ * @param groupKey The smallest key left in the range.
+ * @param task The index of the key range, reported if emitAggregate throws.
+ * @return The number of pairs folded.
+ */
+size_t aggregateRangeGroup(ThreadContext *tc, std::vector<size_t>& heads, const KeyRange& range,
+                           K2* groupKey, const size_t task) {
+	JobContext* context = tc->context;
+	const AggregatingClient* aggregator = context->aggregator;
+	Aggregate aggregate;
+	bool keyConsumed = false;
+	try {
+		for (size_t i = 0; i < heads.size(); ++i) {
+			const SegmentedBuffer& vec = context->intermediateVecs[i];
+			// Since groupKey is the smallest key, a key is equal to it iff it is not greater than it
+			while (heads[i] < range.end[i] && !(*groupKey < *vec[heads[i]].first)) {
+				const auto [key, value] = vec[heads[i]++];
+				aggregate.add(static_cast<const NumericValue*>(value)->value);
+				keyConsumed = keyConsumed || key == groupKey;
+				// groupKey itself is still needed for the comparisons, so it is never released here
+				aggregator->releaseIntermediate(key == groupKey ? nullptr : key, value);
+			}
+		}
+	} catch (...) {
+		if (keyConsumed) {
+			aggregator->releaseIntermediate(groupKey, nullptr); // The group is never emitted
+		}
+		releaseMemory(context, aggregate.count() * context->pairBytes);
+		throw;
+	}
+	releaseMemory(context, aggregate.count() * context->pairBytes);
+	profiledCall(tc, REDUCE_STAGE, task, [&] {
+		aggregator->emitAggregate(groupKey, aggregate.result(aggregator->aggregate()), tc);
+	});
+	return aggregate.count();
+}
+
+/**
+ * This function hands all the pairs of a key range back to the client, without reducing them.
+ * @param client The implementation of MapReduceClient, where releaseIntermediate is defined.
+ * @param context The job context.
+ * @param range The key range to release.
+ */
+void discardKeyRange(const MapReduceClient& client, JobContext* context, const KeyRange& range) {
+	size_t released = 0;
+	for (size_t i = 0; i < range.begin.size(); ++i) {
+		const SegmentedBuffer& vec = context->intermediateVecs[i];
+		for (size_t j = range.begin[i]; j < range.end[i]; ++j) {
+			client.releaseIntermediate(vec[j].first, vec[j].second);
+		}
+		released += range.end[i] - range.begin[i];
+	}
+	releaseMemory(context, released * context->pairBytes);
+}
+
+/**
+ * This function hands a shuffled group back to the client, without reducing it.
+ * @param client The implementation of MapReduceClient, where releaseIntermediate is defined.
+ * @param context The job context.
+ * @param index The index of the group.
+ */
+void discardGroup(const MapReduceClient& client, JobContext* context, const size_t index) {
+	if (context->aggregator != nullptr) {
+		// Only the key of a folded group is left
+		context->aggregator->releaseIntermediate(context->aggregatedData[index].first, nullptr);
+		return;
+	}
+	const IntermediateVec& group = context->shuffledData[index];
+	for (const auto& [key, value] : group) {
+		client.releaseIntermediate(key, value);
+	}
+	releaseMemory(context, group.size() * context->pairBytes);
+}
+
+/**
+ * This function hands all the pairs left in the intermediate vectors back to the client.
+ * Used by thread 0 when the job fails before or while the pairs are being shuffled or partitioned.
+ * @param client The implementation of MapReduceClient, where releaseIntermediate is defined.
+ * @param context The job context.
+ */
+void discardIntermediate(const MapReduceClient& client, JobContext* context) {
+	for (auto& vec : context->intermediateVecs) {
+		releaseMemory(context, vec.size() * context->pairBytes);
+		while (!vec.empty()) {
+			client.releaseIntermediate(vec.back().first, vec.back().second);
+			vec.pop_back();
+		}
+	}
+}
+
+/**
+ * This function is the fused shuffle and reduce phase of the streaming mode.
+ * Each thread claims key ranges and merges them from the sorted intermediate vectors,
+ * passing every group to reduce as soon as it is formed. The group is collected in a single
+ * vector which is reused, so the grouped data is never stored as a whole. With an
+ * AggregatingClient, every group is folded straight from the merge instead of being collected.
+ * @param client The implementation of MapReduceClient, where the reduce function is defined.
+ * @param tc The thread context, which contains the thread ID and the job context.
+ */
+void streamingReducePhase(const MapReduceClient& client, ThreadContext *tc) {
+	JobContext* context = tc->context;
+	IntermediateVec group; // Reused for every group, so it only allocates for the largest one
+	if (tc->threadId >= context->reduceLevel) {
+		return; // Not one of the phase's workers
+	}
+	while (true) {
+		passGate(tc);
+		beginTask(tc);
+		// Atomically fetch and increment the next key range index
+		const uint32_t oldValue = claimTask(tc, context->nextReduceIndex, context->keyRanges.size(),
+		                                    tc->reduceClaimed, context->reduceLevel);
+		if (oldValue >= context->keyRanges.size()) {
+			break; // All key ranges have been processed
+		}
+		const KeyRange& range = context->keyRanges[oldValue];
+		tc->currentTask = oldValue;
+		if (isAborting(context)) {
+			discardKeyRange(client, context, range); // The job failed, so the range is only released
+			endTask(tc);
+			continue;
+		}
+		std::vector<size_t> heads = range.begin;
+		group.clear();
+		bool reducing = false; // Whether the group was handed to reduce, which owns it from then on
+
+		try {
+			while (true) {
+				// Find the min key at the head of the range in any of the vectors
+				K2* minKey = nullptr;
+				for (size_t i = 0; i < heads.size(); ++i) {
+					if (heads[i] < range.end[i]) {
+						if (K2* candidate = context->intermediateVecs[i][heads[i]].first;
+							minKey == nullptr || *candidate < *minKey) {
+							minKey = candidate;
+						}
+					}
+				}
+
+				if (minKey == nullptr) {
+					break; // The key range is exhausted
+				}
+
+				if (context->aggregator != nullptr) {
+					context->stateManager.incrementProcessed(
+						aggregateRangeGroup(tc, heads, range, minKey, oldValue)
+					);
+					continue;
+				}
+
+				// Since minKey is the smallest key, a key is equal to it iff it is not greater than it
+				group.clear();
+				reducing = false;
+				for (size_t i = 0; i < heads.size(); ++i) {
+					const SegmentedBuffer& vec = context->intermediateVecs[i];
+					while (heads[i] < range.end[i] && !(*minKey < *vec[heads[i]].first)) {
+						group.push_back(vec[heads[i]++]);
+					}
+				}
 
-		for (auto& vec : context->intermediateVecs) {
-			while (!vec.empty() && !(*vec.back().first < *maxKey) &&
-				   !(*maxKey < *vec.back().first)) {
-				// If we get here, it means that the key is equal to maxKey
-				// Move the pair from the intermediate vector to the shuffled data
-				currentGroup.emplace_back(vec.back().first, vec.back().second);
-				vec.pop_back(); // Remove the pair from the intermediate vector
-				context->stateManager.incrementProcessed(); // Increment the processed count
+				reducing = true;
+				profiledCall(tc, REDUCE_STAGE, oldValue, [&] { client.reduce(&group, tc); });
+				releaseMemory(context, group.size() * context->pairBytes);
+				context->stateManager.incrementProcessed(group.size());
+				group.clear();
+			}
+		} catch (...) {
+			// The range is claimed by this thread, so the rest of it is released before giving up,
+			// along with a group that was collected but not handed to reduce
+			if (!reducing) {
+				for (const auto& [key, value] : group) {
+					client.releaseIntermediate(key, value);
+				}
 			}
+			releaseMemory(context, group.size() * context->pairBytes);
+			discardKeyRange(client, context, KeyRange{heads, range.end});
+			throw;
 		}
-
-		// Since we have added a new vector to shuffledData,
-		// we need to increment the shuffle counter
-		context->shuffleCounter.fetch_add(1, std::memory_order_relaxed);
+		endTask(tc);
 	}
+	yieldSlot(tc);
+	openGate(context, context->reduceThreads);
 }
 
 /**
@@ -182,35 +1595,332 @@ void shufflePhase(const ThreadContext *tc) {
  * @param tc The thread context, which contains the thread ID and the job context.
  */
 void reducePhase(const MapReduceClient& client, ThreadContext *tc) {
+	if (tc->threadId >= tc->context->reduceLevel) {
+		return; // Not one of the phase's workers
+	}
 	while (true) {
+		passGate(tc);
+		beginTask(tc);
 		// Atomically fetch and increment the next reduce index
-		const uint32_t oldValue = tc->context->nextReduceIndex.fetch_add(1, std::memory_order_relaxed);
+		const uint32_t oldValue = claimTask(tc, tc->context->nextReduceIndex,
+		                                    tc->context->shuffleCounter.load(std::memory_order_relaxed),
+		                                    tc->reduceClaimed,
+		                                    tc->context->reduceLevel);
 
 		// Check if the index is within bounds (number of vectors in the shuffled data)
 		if (oldValue >= tc->context->shuffleCounter.load(std::memory_order_relaxed)) {
 			break; // All input pairs have been processed
 		}
 
+		tc->currentTask = oldValue;
+		if (isAborting(tc->context)) {
+			discardGroup(client, tc->context, oldValue); // The job failed, so the group is only released
+			endTask(tc);
+			continue;
+		}
+
 		// Safely process the shuffled data at the fetched index
 		// No need to synchronize access to shuffledData,
 		// since only the current thread has the value of oldValue
-		client.reduce(&tc->context->shuffledData[oldValue], tc);
+		if (const AggregatingClient* aggregator = tc->context->aggregator; aggregator != nullptr) {
+			// The group was already folded during the shuffle, only its output is left to emit
+			auto&[key, aggregate] = tc->context->aggregatedData[oldValue];
+			profiledCall(tc, REDUCE_STAGE, oldValue, [&] {
+				aggregator->emitAggregate(key, aggregate.result(aggregator->aggregate()), tc);
+			});
+		} else {
+			const IntermediateVec& group = tc->context->shuffledData[oldValue];
+			profiledCall(tc, REDUCE_STAGE, oldValue, [&] { client.reduce(&group, tc); });
+			releaseMemory(tc->context, group.size() * tc->context->pairBytes);
+		}
 		// Since we have reduced (processed) a vector,
 		// Increment the processed count in the job context. This is done atomically.
 		tc->context->stateManager.incrementProcessed();
+		endTask(tc);
 	}
+	yieldSlot(tc);
+	openGate(tc->context, tc->context->reduceThreads);
 }
 
 void emit3 (K3* key, V3* value, void* context) {
-	const auto *tc = static_cast<ThreadContext*>(context);
+	auto *tc = static_cast<ThreadContext*>(context);
+	// The budget is only enforced while mapping, the output is tracked but never rejected
+	accountMemory(tc, sizeof(OutputPair), false);
+	if (tc->ownOutput != nullptr) {
+		tc->ownOutput->emplace_back(key, value); // Written to the output in order once all the workers are done
+		return;
+	}
+	if (OutputQueue* queue = tc->context->outputQueue.get(); queue != nullptr) {
+		// Each thread fills its own chunk, and publishes it without locking once it is full
+		queue->emit(tc->outputChunk, key, value);
+		return;
+	}
 	// Lock the output vector for thread safety
 	std::lock_guard<std::mutex> lock(tc->context->outMutex);
 	// Add the key-value pair to the output vector
-	tc->context->outputVec.emplace_back(key, value);
+	tc->context->outputVec->emplace_back(key, value);
 	// There is no need to unlock the mutex explicitly,
 	// as it will be released when going out of scope
 }
 
+/**
+ * This function publishes the thread's last output chunk, and once all the threads have done so,
+ * thread 0 moves whatever the consumer has not taken yet into the output vector.
+ * @param tc The thread context, which contains the thread's current output chunk.
+ */
+void collectQueuedOutput(ThreadContext *tc) {
+	JobContext* context = tc->context;
+	context->outputQueue->flush(tc->outputChunk);
+
+	// All the threads must publish their last chunk before it is drained
+	context->barrier->barrier();
+
+	if (tc->threadId == THREAD_ZERO) {
+		std::lock_guard<std::mutex> lock(context->drainMutex);
+		context->outputQueue->drain(*context->outputVec);
+	}
+}
+
+/**
+ * This function runs a part of the thread's work, recording an exception thrown from it as the
+ * job's error instead of letting it terminate the process.
+ * @param tc The thread context.
+ * @param stage The stage the work belongs to.
+ * @param work The work to run.
+ * @return true if the work returned normally, false if it threw.
+ */
+template <typename Work>
+bool runGuarded(ThreadContext *tc, const stage_t stage, Work&& work) {
+	try {
+		work();
+		return true;
+	} catch (...) {
+		recordError(tc->context, stage, tc->currentTask, std::current_exception());
+		yieldSlot(tc); // The work did not get to give its scheduler slot back
+		return false;
+	}
+}
+
+/**
+ * This function mixes the digest of a single output pair, so that similar digests (e.g. small
+ * integers) affect all the bits of the output's digest.
+ * @param digest The digest of the pair.
+ * @return The mixed digest (the splitmix64 finalizer).
+ */
+uint64_t mixDigest(uint64_t digest) {
+	digest = (digest ^ (digest >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	digest = (digest ^ (digest >> 27)) * 0x94d049bb133111ebULL;
+	return digest ^ (digest >> 31);
+}
+
+/**
+ * This function writes the output of a deterministic run once all the threads are done reducing.
+ * Thread 0 adds the output of every thread in turn, which is the order of the groups since the
+ * threads reduce contiguous shares of them, and computes the digest of the output.
+ * If the output is to be sorted, only the digest is computed here, in the order of the groups.
+ * @param client The implementation of MapReduceClient, where outputDigest is defined.
+ * @param tc The thread context.
+ */
+void writeOrderedOutput(const MapReduceClient& client, ThreadContext *tc) {
+	JobContext* context = tc->context;
+	// All the threads must be done emitting before their output is read
+	context->barrier->barrier();
+	if (tc->threadId != THREAD_ZERO) {
+		return;
+	}
+
+	uint64_t digest = DIGEST_OFFSET;
+	size_t pairs = 0;
+	const bool digested = runGuarded(tc, REDUCE_STAGE, [&] {
+		for (const auto& workerOutput : context->workerOutputs) {
+			for (const auto&[key, value] : workerOutput) {
+				digest = (digest ^ mixDigest(client.outputDigest(key, value))) * DIGEST_PRIME;
+			}
+			pairs += workerOutput.size();
+		}
+	});
+
+	OutputQueue* queue = context->outputQueue.get();
+	if (!context->sortOutput) {
+		std::lock_guard<std::mutex> lock(context->outMutex);
+		for (auto& workerOutput : context->workerOutputs) {
+			for (const auto&[key, value] : workerOutput) {
+				if (queue != nullptr) {
+					queue->emit(tc->outputChunk, key, value);
+				} else {
+					context->outputVec->emplace_back(key, value);
+				}
+			}
+			workerOutput.clear();
+		}
+	}
+	if (digested) {
+		context->outputDigest.store((digest ^ pairs) * DIGEST_PRIME, std::memory_order_relaxed);
+	}
+}
+
+/**
+ * This function compares two output pairs by their keys.
+ */
+bool outputKeyLess(const OutputPair& a, const OutputPair& b) {
+	return *a.first < *b.first;
+}
+
+/**
+ * This function gets the vector the sorted output is merged into.
+ * @param context The job context.
+ * @return The output vector, or the job's merge vector if the output is published through the queue.
+ */
+OutputVec& mergeTarget(JobContext* context) {
+	return context->outputQueue != nullptr ? context->mergedOutput : *context->outputVec;
+}
+
+/**
+ * This function splits the sorted outputs of the workers into one part per worker, at keys
+ * sampled from all of them, so that all the pairs of a given key fall in a single part.
+ * It then makes room for the merged pairs in the merge's target vector.
+ * @param context The job context, whose sortedOutputs are sorted.
+ */
+void splitSortedOutput(JobContext* context) {
+	const auto& outputs = context->sortedOutputs;
+	const size_t parts = outputs.size();
+	size_t totalPairs = 0;
+	for (const auto& output : outputs) {
+		totalPairs += output.size();
+	}
+
+	// Sample the keys at a fixed stride, so that each sample stands for the same number of pairs
+	const size_t stride = std::max<size_t>(1, totalPairs / (parts * SAMPLES_PER_RANGE));
+	std::vector<const K3*> samples;
+	for (const auto& output : outputs) {
+		for (size_t i = stride / 2; i < output.size(); i += stride) {
+			samples.push_back(output[i].first);
+		}
+	}
+	std::sort(samples.begin(), samples.end(), [](const K3* a, const K3* b) { return *a < *b; });
+
+	// Each part starts at the first pair not less than its boundary in every output
+	context->outputSplits.assign(parts + 1, std::vector<size_t>(parts, 0));
+	for (size_t part = 1; part < parts && !samples.empty(); ++part) {
+		const K3* boundary = samples[part * samples.size() / parts];
+		for (size_t i = 0; i < parts; ++i) {
+			context->outputSplits[part][i] = static_cast<size_t>(std::lower_bound(
+				outputs[i].begin(), outputs[i].end(), boundary,
+				[](const OutputPair& pair, const K3* key) { return *pair.first < *key; }) - outputs[i].begin());
+		}
+	}
+	for (size_t i = 0; i < parts; ++i) {
+		context->outputSplits[parts][i] = outputs[i].size();
+	}
+
+	std::lock_guard<std::mutex> lock(context->outMutex);
+	mergeTarget(context).resize(context->mergeBase + totalPairs);
+}
+
+/**
+ * This function merges a single part of the sorted outputs into the merge's target vector.
+ * The part's pairs go right after the pairs of the parts before it, which are all smaller.
+ * @param context The job context, whose sorted outputs are split.
+ * @param part The part to merge.
+ */
+void mergeOutputPart(JobContext* context, const size_t part) {
+	const auto& outputs = context->sortedOutputs;
+	std::vector<size_t> heads = context->outputSplits[part];
+	const std::vector<size_t>& ends = context->outputSplits[part + 1];
+	size_t position = context->mergeBase;
+	for (const size_t head : heads) {
+		position += head;
+	}
+
+	OutputVec& target = mergeTarget(context);
+	while (true) {
+		// Take the smallest head, and the first of the outputs on a tie so that the merge is stable
+		size_t next = outputs.size();
+		for (size_t i = 0; i < outputs.size(); ++i) {
+			if (heads[i] < ends[i] &&
+				(next == outputs.size() || outputKeyLess(outputs[i][heads[i]], outputs[next][heads[next]]))) {
+				next = i;
+			}
+		}
+		if (next == outputs.size()) {
+			break; // The part is exhausted
+		}
+		target[position++] = outputs[next][heads[next]++];
+	}
+}
+
+/**
+ * This function writes the output of the run sorted by key once all the threads are done reducing.
+ * Every thread sorts a copy of its own output, and after thread 0 splits the key space, merges
+ * its part of the sorted outputs into its own place in the output. A copy is sorted so that if
+ * a comparison throws, thread 0 can still write the whole output, unsorted.
+ * @param tc The thread context.
+ */
+void writeSortedOutput(ThreadContext *tc) {
+	JobContext* context = tc->context;
+	const auto threadId = static_cast<size_t>(tc->threadId);
+	if (context->deterministic) {
+		// Thread 0 may still be digesting the output in the order of the groups
+		context->barrier->barrier();
+	}
+	if (threadId == THREAD_ZERO) {
+		context->mergeBase = mergeTarget(context).size();
+	}
+
+	runGuarded(tc, REDUCE_STAGE, [&] {
+		beginTask(tc);
+		OutputVec& sorted = context->sortedOutputs[threadId];
+		sorted = context->workerOutputs[threadId];
+		std::stable_sort(sorted.begin(), sorted.end(), outputKeyLess);
+		yieldSlot(tc);
+	});
+
+	// All the outputs must be sorted before they are split
+	context->barrier->barrier();
+	if (threadId == THREAD_ZERO && !isAborting(context)) {
+		runGuarded(tc, REDUCE_STAGE, [&] { splitSortedOutput(context); });
+	}
+
+	// All the threads must wait for the split before merging their parts
+	context->barrier->barrier();
+	if (!isAborting(context)) {
+		runGuarded(tc, REDUCE_STAGE, [&] {
+			beginTask(tc);
+			mergeOutputPart(context, threadId);
+			yieldSlot(tc);
+		});
+	}
+
+	// All the parts must be merged before the output is published
+	context->barrier->barrier();
+	if (threadId != THREAD_ZERO) {
+		return;
+	}
+	OutputQueue* queue = context->outputQueue.get();
+	{
+		std::lock_guard<std::mutex> lock(context->outMutex);
+		OutputVec& target = mergeTarget(context);
+		if (isAborting(context)) {
+			// The job failed, maybe while sorting, so the output is written as it was emitted
+			target.resize(context->mergeBase);
+			for (const auto& workerOutput : context->workerOutputs) {
+				target.insert(target.end(), workerOutput.begin(), workerOutput.end());
+			}
+		}
+		if (queue != nullptr) {
+			for (const auto&[key, value] : target) {
+				queue->emit(tc->outputChunk, key, value);
+			}
+			target.clear();
+		}
+	}
+	for (size_t i = 0; i < context->workerOutputs.size(); ++i) {
+		context->workerOutputs[i].clear();
+		context->sortedOutputs[i].clear();
+	}
+	context->outputSplits.clear();
+}
+
 /**
  * This function is the main thread function for each worker thread.
  *
@@ -221,41 +1931,204 @@ void emit3 (K3* key, V3* value, void* context) {
  * 4. Thread 0 then shuffles the whole intermediate data
  * 5. All threads wait for thread 0 to finish the shuffle phase
  * 6. Finally, all threads run the reduce phase
+ * An exception thrown in any phase is recorded as the job's error, and the threads go on
+ * through the barriers without running new tasks, releasing the pairs that were not reduced.
  * @param context The job context, which contains the job state and other relevant data.
  * @param client The implementation of MapReduceClient, where the map and reduce functions are defined.
  * @param threadId The ID of the thread executing this function.
  * @param intermediateVec The thread's intermediate vector, which stores the intermediate key-value pairs.
  */
 void threadFunc(JobContext* context, const MapReduceClient& client,
-                const int threadId, IntermediateVec* intermediateVec) {
+                const int threadId, SegmentedBuffer* intermediateVec) {
+	{
+		// Wait for all the threads to be created, since the barriers count on every one of them
+		std::unique_lock<std::mutex> lock(context->launchMutex);
+		context->launchCv.wait(lock, [context] { return context->launchState != LAUNCH_PENDING; });
+		if (context->launchState == LAUNCH_FAILED) {
+			return;
+		}
+	}
+
 	// Create a thread context for each thread
-	ThreadContext tc{threadId, context, intermediateVec};
+	ThreadContext tc{threadId, context, intermediateVec, nullptr, 0, 0, 0, nullptr, false, 0, nullptr, NO_TASK_INDEX,
+	                 context->taskProfiles.empty() ? nullptr : &context->taskProfiles[threadId],
+	                 context->workerOutputs.empty() ? nullptr : &context->workerOutputs[threadId], 0};
+
+	// The counters are opened by the worker itself, since they count the thread that opens them
+	PerfCounters perf(context->perfCounters);
+	if (context->perfCounters) {
+		std::lock_guard<std::mutex> lock(context->perfMutex);
+		context->perfEvents &= perf.available();
+	}
 
-	mapPhase(client, &tc); // First, the thread runs the map phase
+	// First, the thread runs the map phase
+	perf.start();
+	if (!runGuarded(&tc, MAP_STAGE, [&] { mapPhase(client, &tc); })) {
+		// The phase was cut short, so whatever it left behind is cleaned up here
+		openGate(context, context->mapThreads);
+		tc.staging = nullptr;
+	}
+	stopCounting(&tc, perf, PERF_MAP);
 
-	sortPhase(&tc); // Then, the thread sorts its intermediate data
+	tc.currentTask = NO_TASK_INDEX;
+	perf.start();
+	runGuarded(&tc, MAP_STAGE, [&] { sortPhase(&tc); }); // Then, the thread sorts its intermediate data
+	stopCounting(&tc, perf, PERF_SORT);
 
 	// The thread waits for all other threads to finish map phase
 	context->barrier->barrier();
 
-	if (threadId == THREAD_ZERO) { // Make sure only thread 0 is calling shuffle
-		context->stateManager.setStage(SHUFFLE_STAGE);
-		shufflePhase(&tc);
-		// Reset the state since we are starting the reduce phase
-		context->stateManager.updateState(
-			REDUCE_STAGE, 0, context->shuffleCounter.load(std::memory_order_relaxed)
-		);
+	// Only thread 0 checks whether the job failed or exceeded its budget before the shuffle, and all
+	// the threads go on to the next barrier either way: the shuffle itself may fail the job while
+	// the other threads would still be checking
+	if (context->streamingReduce) {
+		if (threadId == THREAD_ZERO) {
+			context->stateManager.setStage(SHUFFLE_STAGE);
+			size_t totalPairs = 0;
+			perf.start();
+			if (isAborting(context) ||
+			    !runGuarded(&tc, SHUFFLE_STAGE, [&] { totalPairs = partitionKeyRanges(&tc); })) {
+				context->keyRanges.clear(); // The ranges may not cover all the pairs, so release them here
+				discardIntermediate(client, context);
+			}
+			stopCounting(&tc, perf, PERF_SHUFFLE);
+			// The fused phase reports its progress in intermediate pairs
+			context->stateManager.updateState(REDUCE_STAGE, 0, totalPairs);
+			context->resetGate(context->reduceLevel);
+		}
+		// All the threads must wait for the key ranges before merging them
+		context->barrier->barrier();
+		// A thread whose task threw goes on releasing the remaining key ranges
+		perf.start();
+		while (!runGuarded(&tc, REDUCE_STAGE, [&] { streamingReducePhase(client, &tc); })) {}
+		stopCounting(&tc, perf, PERF_REDUCE);
+		if (threadId < context->reduceLevel) {
+			openGate(context, context->reduceThreads); // The phase's workers tell when it is over
+		}
+	} else {
+		if (threadId == THREAD_ZERO) { // Make sure only thread 0 is calling shuffle
+			context->stateManager.setStage(SHUFFLE_STAGE);
+			perf.start();
+			if (isAborting(context) || !runGuarded(&tc, SHUFFLE_STAGE, [&] { shufflePhase(&tc); }) ||
+			    isAborting(context)) {
+				discardIntermediate(client, context); // The groups formed so far are released by reduce
+			}
+			stopCounting(&tc, perf, PERF_SHUFFLE);
+			// Reset the state since we are starting the reduce phase
+			context->stateManager.updateState(
+				REDUCE_STAGE, 0, context->shuffleCounter.load(std::memory_order_relaxed)
+			);
+			context->resetGate(context->reduceLevel);
+		}
+
+		// All the threads must wait for thread 0 to finish
+		// the shuffle phase before continuing to the reduce phase
+		context->barrier->barrier();
+
+		// After the shuffle phase, it runs the reduce phase
+		// A thread whose task threw goes on releasing the remaining groups
+		perf.start();
+		while (!runGuarded(&tc, REDUCE_STAGE, [&] { reducePhase(client, &tc); })) {}
+		stopCounting(&tc, perf, PERF_REDUCE);
+		if (threadId < context->reduceLevel) {
+			openGate(context, context->reduceThreads); // The phase's workers tell when it is over
+		}
 	}
 
-	// All the threads must wait for thread 0 to finish
-	// the shuffle phase before continuing to the reduce phase
-	context->barrier->barrier();
+	// The thread emits nothing more, so the part of its charge it did not use is given back
+	releaseMemory(context, tc.chargedBytes - tc.usedBytes);
+	tc.chargedBytes = tc.usedBytes;
+
+	if (context->deterministic) {
+		writeOrderedOutput(client, &tc);
+	}
+
+	if (context->sortOutput) {
+		writeSortedOutput(&tc);
+	}
+
+	if (context->outputQueue != nullptr) {
+		collectQueuedOutput(&tc);
+	}
 
-	reducePhase(client, &tc); // After the shuffle phase, it runs the reduce phase
+	if (threadId == THREAD_ZERO && isAborting(context)) {
+		context->stateManager.updateState(REDUCE_STAGE, 0, 0); // Done, so the callers stop waiting
+	}
 }
 
 JobHandle startMapReduceJob(const MapReduceClient& client, const InputVec& inputVec,
 							OutputVec& outputVec, const int multiThreadLevel) {
+	JobConfig config;
+	config.multiThreadLevel = multiThreadLevel;
+	return startMapReduceJob(client, inputVec, outputVec, config);
+}
+
+/**
+ * This function counts workers of the run as exited, and records the end of the run once the last
+ * one has.
+ * @param context The job context.
+ * @param count The number of workers that exited.
+ */
+void endWorkers(JobContext* context, const int count) {
+	if (context->runningWorkers.fetch_sub(count, std::memory_order_acq_rel) == count) {
+		context->runEnd.store(nowNanos(), std::memory_order_relaxed); // The run is over
+	}
+}
+
+/**
+ * This function runs a single worker of the job, on a thread of its own or on the caller's thread.
+ * @param context The job context.
+ * @param client The implementation of MapReduceClient, where the map and reduce functions are defined.
+ * @param threadId The ID of the worker.
+ */
+void runWorker(JobContext* context, const MapReduceClient& client, const int threadId) {
+	threadFunc(context, client, threadId, &context->intermediateVecs[threadId]);
+	endWorkers(context, 1);
+}
+
+/**
+ * This function starts a run of the job, creating its worker threads.
+ * @param context The job context, already prepared for the run.
+ * @param client The implementation of MapReduceClient, where the map and reduce functions are defined.
+ * @param firstThread The ID of the first worker to create a thread for. The workers before it
+ *					  are run by the caller, once the threads are created.
+ */
+void launchThreads(JobContext* context, const MapReduceClient& client, const int firstThread = 0) {
+	const int multiThreadLevel = static_cast<int>(context->intermediateVecs.size());
+	context->threads.reserve(multiThreadLevel - firstThread); // Reserve space for all the threads
+	int launchState = LAUNCH_READY;
+	for (int i = firstThread; i < multiThreadLevel; ++i) {
+		try {
+			// Create a thread that runs the map-reduce job
+			context->threads.emplace_back([=, &client, threadId = i]() { runWorker(context, client, threadId); });
+		} catch (const std::system_error&) {
+			// The threads that were created exit right away, and the job fails instead of the process
+			recordError(context, UNDEFINED_STAGE, NO_TASK_INDEX, std::current_exception());
+			context->stateManager.updateState(REDUCE_STAGE, 0, 0);
+			launchState = LAUNCH_FAILED;
+			break;
+		}
+	}
+	if (launchState == LAUNCH_FAILED) {
+		// The workers that were never started will not exit, so they are counted out here
+		endWorkers(context, multiThreadLevel - firstThread - static_cast<int>(context->threads.size()));
+	}
+	{
+		std::lock_guard<std::mutex> lock(context->launchMutex);
+		context->launchState = launchState;
+	}
+	context->launchCv.notify_all();
+}
+
+JobHandle startMapReduceJob(const MapReduceClient& client, const InputVec& inputVec,
+							OutputVec& outputVec, const JobConfig& config) {
+	if (!inputVec.empty() && inputVec.size() <= config.inlineInputPairs) {
+		// A small job is done sooner by the caller alone than by starting the workers
+		JobConfig inlineConfig = config;
+		inlineConfig.multiThreadLevel = 1;
+		return runMapReduceJob(client, inputVec, outputVec, inlineConfig);
+	}
+
 	// Lock the mutex to ensure thread-safe execution
 	std::lock_guard<std::mutex> lock(jobCreationMutex);
 
@@ -264,30 +2137,60 @@ JobHandle startMapReduceJob(const MapReduceClient& client, const InputVec& input
 	}
 
 	// Create the job's context
-	JobContext *context;
-	try {
-		context = new JobContext(inputVec, outputVec, multiThreadLevel);
-	} catch (const std::bad_alloc& e) {
-		printf(SYS_ERR, e.what());
-		exit(EXIT_FAILURE);
-	}
+	// If it cannot be allocated, std::bad_alloc is thrown to the caller, as no job was started
+	auto context = std::make_unique<JobContext>(config, false);
+	context->prepareRun(client, inputVec, outputVec);
+	launchThreads(context.get(), client);
+	return context.release();
+	// The mutex will now be unlocked automatically when going out of scope, ensuring thread safety
+}
 
-	context->threads.reserve(multiThreadLevel); // Reserve space for all the threads
-	for (int i = 0; i < multiThreadLevel; ++i) {
-		try {
-			// Create a thread that runs the map-reduce job
-			context->threads.emplace_back(
-				[=, &client, threadId = i, intermediateVec = &context->intermediateVecs[i]]() {
-					threadFunc(context, client, threadId, intermediateVec);
-				}
-			);
-		} catch (const std::system_error& e) {
-			printf(SYS_ERR, e.what());
-			exit(EXIT_FAILURE);
+JobHandle runMapReduceJob(const MapReduceClient& client, const InputVec& inputVec,
+                          OutputVec& outputVec, const JobConfig& config) {
+	std::unique_ptr<JobContext> context;
+	{
+		// Lock the mutex to ensure thread-safe execution
+		std::lock_guard<std::mutex> lock(jobCreationMutex);
+		if (inputVec.empty()) {
+			return nullptr; // No input pairs to process
 		}
+		context = std::make_unique<JobContext>(config, false);
+		context->prepareRun(client, inputVec, outputVec);
+		launchThreads(context.get(), client, THREAD_ZERO + 1);
 	}
-	return context;
-	// The mutex will now be unlocked automatically when going out of scope, ensuring thread safety
+	// The caller is worker 0 (the one which shuffles), and is done once the whole run is
+	runWorker(context.get(), client, THREAD_ZERO);
+	waitForJob(context.get());
+	return context.release();
+}
+
+JobHandle createReusableJob(const JobConfig& config) {
+	return new JobContext(config, true); // Throws std::bad_alloc to the caller if it cannot be allocated
+}
+
+void restartMapReduceJob(JobHandle job, const MapReduceClient& client,
+                         const InputVec& inputVec, OutputVec& outputVec) {
+	waitForJob(job); // The previous run must be over before its buffers are reset
+	auto *context = static_cast<JobContext*>(job);
+
+	// Lock the mutex to ensure thread-safe execution
+	std::lock_guard<std::mutex> lock(jobCreationMutex);
+	context->prepareRun(client, inputVec, outputVec);
+	launchThreads(context, client);
+}
+
+void rerunMapReduceJob(JobHandle job, const MapReduceClient& client,
+                       const InputVec& inputVec, OutputVec& outputVec) {
+	waitForJob(job); // The previous run must be over before its buffers are reset
+	auto *context = static_cast<JobContext*>(job);
+	{
+		// Lock the mutex to ensure thread-safe execution
+		std::lock_guard<std::mutex> lock(jobCreationMutex);
+		context->prepareRun(client, inputVec, outputVec);
+		launchThreads(context, client, THREAD_ZERO + 1);
+	}
+	runWorker(context, client, THREAD_ZERO);
+	waitForJob(job);
 }
 
 void getJobState(JobHandle job, JobState *state) {
@@ -312,6 +2215,213 @@ void getJobState(JobHandle job, JobState *state) {
 	);
 }
 
+void setJobBroadcast(JobHandle job, const void* value) {
+	if (job == nullptr) {
+		return; // Nothing to do
+	}
+	static_cast<JobContext*>(job)->broadcast = value;
+}
+
+const void* getBroadcast(void* context) {
+	// The broadcast value is only written between runs, so it can be read without synchronization
+	return static_cast<const ThreadContext*>(context)->context->broadcast;
+}
+
+bool getJobError(JobHandle job, JobError* error) {
+	if (job == nullptr) {
+		return false; // Nothing was run
+	}
+	auto *context = static_cast<JobContext*>(job);
+	std::lock_guard<std::mutex> lock(context->errorMutex);
+	if (context->error == nullptr) {
+		return false;
+	}
+	error->stage = context->errorStage;
+	error->taskIndex = context->errorTask;
+	error->exception = context->error;
+	return true;
+}
+
+void waitForJobOrThrow(JobHandle job) {
+	waitForJob(job);
+	if (JobError error; getJobError(job, &error)) {
+		std::rethrow_exception(error.exception);
+	}
+}
+
+void getFailedMapInputs(JobHandle job, std::vector<size_t>& indices) {
+	if (job == nullptr) {
+		return; // Nothing was mapped
+	}
+	auto *context = static_cast<JobContext*>(job);
+	std::lock_guard<std::mutex> lock(context->failedMutex);
+	const size_t begin = indices.size();
+	indices.insert(indices.end(), context->failedMapInputs.begin(), context->failedMapInputs.end());
+	std::sort(indices.begin() + static_cast<std::ptrdiff_t>(begin), indices.end());
+}
+
+void getTaskProfile(JobHandle job, TaskProfile& profile) {
+	if (job == nullptr) {
+		profile = TaskProfile();
+		return; // Nothing was run
+	}
+	const auto *context = static_cast<JobContext*>(job);
+	profile = TaskProfile(context->taskProfiles.empty() ? 0 : context->taskProfiles.front().maxSlowestTasks());
+	for (const auto& threadProfile : context->taskProfiles) {
+		profile.merge(threadProfile);
+	}
+}
+
+bool isMapSuperseded(void* context) {
+	const auto *tc = static_cast<const ThreadContext*>(context);
+	if (!tc->context->speculativeMap || tc->staging == nullptr) {
+		return false; // The job does not speculate, so every map call is kept
+	}
+	const uint32_t index = tc->context->runningTasks[tc->threadId].index.load(std::memory_order_relaxed);
+	return index != NO_TASK &&
+	       (tc->context->taskStates[index].load(std::memory_order_acquire) & TASK_COMMITTED) != 0;
+}
+
+size_t pollJobOutput(JobHandle job, OutputVec& out) {
+	if (job == nullptr) {
+		return 0; // Nothing to do
+	}
+	auto *context = static_cast<JobContext*>(job);
+	if (context->outputQueue == nullptr) {
+		return 0; // The output is only added to the job's output vector
+	}
+	std::lock_guard<std::mutex> lock(context->drainMutex);
+	return context->outputQueue->drain(out);
+}
+
+void getJobStats(JobHandle job, JobStats* stats) {
+	*stats = JobStats{};
+	if (job == nullptr) {
+		return; // Nothing was done
+	}
+	auto *context = static_cast<JobContext*>(job);
+	stats->memoryUsedBytes = context->memoryUsed.load(std::memory_order_relaxed);
+	stats->memoryHighWaterBytes = context->memoryHighWater.load(std::memory_order_relaxed);
+	stats->memoryBudgetExceeded = context->memoryBudgetExceeded.load(std::memory_order_relaxed);
+	stats->mapThreads = context->mapThreads.load(std::memory_order_relaxed);
+	stats->reduceThreads = context->reduceThreads.load(std::memory_order_relaxed);
+	stats->speculativeTasks = context->speculativeTasks.load(std::memory_order_relaxed);
+	stats->speculativeWins = context->speculativeWins.load(std::memory_order_relaxed);
+	stats->retriedMapCalls = context->retriedMapCalls.load(std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(context->failedMutex);
+		stats->failedMapInputs = context->failedMapInputs.size();
+	}
+	stats->outputDigest = context->outputDigest.load(std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lock(context->perfMutex);
+	stats->perfEvents = context->perfEvents;
+	for (const auto& worker : context->workerCounters) {
+		for (int phase = 0; phase < PERF_PHASES; ++phase) {
+			stats->perfCounters[phase].nanos += worker[phase].nanos;
+			stats->perfCounters[phase].cycles += worker[phase].cycles;
+			stats->perfCounters[phase].instructions += worker[phase].instructions;
+			stats->perfCounters[phase].cacheMisses += worker[phase].cacheMisses;
+			stats->perfCounters[phase].branchMisses += worker[phase].branchMisses;
+		}
+	}
+}
+
+void getJobProgress(JobHandle job, JobProgress* progress) {
+	*progress = JobProgress{REDUCE_STAGE, MAX_PERCENTAGE, MAX_PERCENTAGE, 0, 0, 0};
+	if (job == nullptr) {
+		return; // Nothing to do, so the job is done
+	}
+	const auto *context = static_cast<JobContext*>(job);
+	const JobStateManager& state = context->stateManager;
+	uint32_t processed;
+	uint32_t total;
+	state.getState(progress->stage, processed, total);
+	progress->stagePercentage = total == 0 ? MAX_PERCENTAGE : std::min(
+		static_cast<float>(processed) / static_cast<float>(total) * MAX_PERCENTAGE, MAX_PERCENTAGE);
+
+	const int64_t now = nowNanos();
+	const int64_t runStart = state.getStageStart(UNDEFINED_STAGE);
+	if (progress->stage == REDUCE_STAGE && processed >= total) {
+		// The run is done, or only its workers are still exiting
+		const int64_t end = context->runEnd.load(std::memory_order_relaxed);
+		const int64_t reduceStart = state.getStageStart(REDUCE_STAGE);
+		const int64_t reduceTime = (end != 0 ? end : now) - reduceStart;
+		progress->throughput = reduceTime > 0 ? processed * NANOS_PER_SECOND / reduceTime : 0;
+		progress->elapsedSeconds = ((end != 0 ? end : now) - runStart) / NANOS_PER_SECOND;
+		return;
+	}
+
+	// Until thread 0 sets the map stage, the time is counted as the map's
+	const int current = progress->stage == UNDEFINED_STAGE ? MAP_STAGE : progress->stage;
+	std::array<double, 4> expected{}; // The expected duration of every stage
+	double spent = 0;
+	for (int stage = MAP_STAGE; stage < current; ++stage) {
+		// A stage skipped by an aborted run has no start, and counts as taking no time
+		const int64_t start = state.getStageStart(static_cast<stage_t>(stage));
+		const int64_t next = state.getStageStart(static_cast<stage_t>(stage + 1));
+		expected[stage] = start != 0 && next > start ? static_cast<double>(next - start) : 0;
+		spent += expected[stage];
+	}
+	const int64_t currentStart = state.getStageStart(static_cast<stage_t>(current));
+	const auto elapsed = static_cast<double>(now - (currentStart != 0 ? currentStart : runStart));
+	spent += elapsed;
+	progress->elapsedSeconds = static_cast<double>(now - runStart) / NANOS_PER_SECOND;
+	progress->throughput = elapsed > 0 ? processed * NANOS_PER_SECOND / elapsed : 0;
+
+	if (processed > 0) {
+		expected[current] = std::max(elapsed, elapsed * total / processed);
+	} else if (current != MAP_STAGE) {
+		expected[current] = std::max(elapsed, expected[MAP_STAGE] * context->stageCosts[current]);
+	} else {
+		progress->overallPercentage = 0;
+		progress->etaSeconds = -1; // Nothing was mapped yet, so there is no rate to go by
+		return;
+	}
+	for (int stage = current + 1; stage <= REDUCE_STAGE; ++stage) {
+		expected[stage] = expected[MAP_STAGE] * context->stageCosts[stage];
+	}
+	const double expectedTotal = expected[MAP_STAGE] + expected[SHUFFLE_STAGE] + expected[REDUCE_STAGE];
+	progress->overallPercentage = expectedTotal <= 0 ? 0 : std::min(
+		static_cast<float>(spent / expectedTotal) * MAX_PERCENTAGE, MAX_PERCENTAGE);
+	progress->etaSeconds = std::max(expectedTotal - spent, 0.0) / NANOS_PER_SECOND;
+}
+
+void getJobMetrics(JobHandle job, JobMetrics* metrics) {
+	*metrics = JobMetrics{};
+	if (job == nullptr) {
+		return; // Nothing was done
+	}
+	const auto *context = static_cast<JobContext*>(job);
+	for (const stage_t stage : {MAP_STAGE, SHUFFLE_STAGE, REDUCE_STAGE}) {
+		metrics->processed[stage] = context->stateManager.getProcessed(stage);
+	}
+	stage_t stage;
+	uint32_t processed;
+	uint32_t total;
+	context->stateManager.getState(stage, processed, total);
+	if (stage == MAP_STAGE || stage == UNDEFINED_STAGE) {
+		const uint32_t claimed = context->nextInputIndex.load(std::memory_order_relaxed);
+		metrics->pendingMapTasks = total - std::min(claimed, total);
+	}
+	metrics->pendingOutputPairs = context->outputQueue != nullptr ? context->outputQueue->pending() : 0;
+	metrics->pendingIoCalls = context->pendingIoCalls.load(std::memory_order_relaxed);
+	metrics->barrierWaits = context->barrier->waits();
+	metrics->barrierWaitNanos = context->barrier->waitNanos();
+}
+
+void getWorkerPerfCounters(JobHandle job, const int worker, PhaseCounters counters[PERF_PHASES]) {
+	std::fill(counters, counters + PERF_PHASES, PhaseCounters{});
+	if (job == nullptr) {
+		return; // Nothing was done
+	}
+	auto *context = static_cast<JobContext*>(job);
+	if (worker < 0 || static_cast<size_t>(worker) >= context->workerCounters.size()) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(context->perfMutex);
+	std::copy(context->workerCounters[worker].begin(), context->workerCounters[worker].end(), counters);
+}
+
 void waitForJob(JobHandle job) {
 	if (job == nullptr) {
 		return; // Nothing to do
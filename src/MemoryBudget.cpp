@@ -0,0 +1,47 @@
+#include "../include/MemoryBudget.h"
+
+#include <algorithm>
+
+MemoryBudget::MemoryBudget(const size_t limitBytes)
+    : usedBytes(0), highWaterBytes(0), limitBytes(limitBytes) {}
+
+bool MemoryBudget::tryCharge(const size_t bytes, const std::chrono::milliseconds maxWait) {
+    std::unique_lock<std::mutex> lock(mutex);
+    // Wait until the charge fits, unless it could never fit
+    if (!cv.wait_for(lock, maxWait, [this, bytes] {
+            return usedBytes + bytes <= limitBytes || bytes > limitBytes;
+        }) || bytes > limitBytes) {
+        return false;
+    }
+    usedBytes += bytes;
+    highWaterBytes = std::max(highWaterBytes, usedBytes);
+    return true;
+}
+
+void MemoryBudget::charge(const size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    usedBytes += bytes;
+    highWaterBytes = std::max(highWaterBytes, usedBytes);
+}
+
+void MemoryBudget::release(const size_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        usedBytes -= std::min(bytes, usedBytes);
+    }
+    cv.notify_all(); // Some of the waiting charges may fit now
+}
+
+size_t MemoryBudget::used() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return usedBytes;
+}
+
+size_t MemoryBudget::highWater() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return highWaterBytes;
+}
+
+size_t MemoryBudget::limit() const {
+    return limitBytes;
+}
@@ -0,0 +1,317 @@
+#include "../include/MetricsRegistry.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <system_error>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define LISTEN_BACKLOG 16
+#define LISTEN_POLL_MS 100 // How often the listener checks whether it should stop
+#define REQUEST_TIMEOUT_MS 1000 // How long a client may take to send its request
+#define MAX_REQUEST_BYTES 8192
+
+/**
+ * The values of a single job, read at the start of a scrape.
+ */
+struct JobSnapshot {
+    std::string labels;
+    JobState state;
+    JobStats stats;
+    JobMetrics metrics;
+    bool failed;
+};
+
+/**
+ * Escapes a label value for the text exposition format.
+ * @param value The label value.
+ * @return The value with its backslashes, quotes and line feeds escaped.
+ */
+static std::string escapeLabel(const std::string& value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (const char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+/**
+ * Appends the HELP and TYPE lines of a metric family.
+ * @param out The exposition text.
+ * @param name The name of the family.
+ * @param type "counter" or "gauge".
+ * @param help The description of the family.
+ */
+static void writeFamily(std::string& out, const char* name, const char* type, const char* help) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+/**
+ * Appends a single sample.
+ * @param out The exposition text.
+ * @param name The name of the sample.
+ * @param labels The labels of the sample, without braces, or an empty string.
+ * @param value The value of the sample.
+ */
+static void writeSample(std::string& out, const char* name, const std::string& labels, const double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.10g", value);
+    out += name;
+    if (!labels.empty()) {
+        out += '{';
+        out += labels;
+        out += '}';
+    }
+    out += ' ';
+    out += buffer;
+    out += '\n';
+}
+
+/**
+ * Appends a metric family with a sample per job.
+ * @param out The exposition text.
+ * @param jobs The snapshots of the jobs.
+ * @param name The name of the family.
+ * @param type "counter" or "gauge".
+ * @param help The description of the family.
+ * @param value Gets the value of the family for a job.
+ */
+template <typename Value>
+static void writeJobFamily(std::string& out, const std::vector<JobSnapshot>& jobs, const char* name,
+                           const char* type, const char* help, Value value) {
+    writeFamily(out, name, type, help);
+    for (const JobSnapshot& job : jobs) {
+        writeSample(out, name, job.labels, static_cast<double>(value(job)));
+    }
+}
+
+/**
+ * @param state The state of a job.
+ * @return Whether the job is done.
+ */
+static bool isDone(const JobState& state) {
+    return state.stage == REDUCE_STAGE && state.percentage >= MAX_PERCENTAGE;
+}
+
+MetricsRegistry::MetricsRegistry()
+    : jobsStarted(0), listenFd(-1), listenPort(0), stopping(false) {}
+
+MetricsRegistry::~MetricsRegistry() {
+    stopServing();
+}
+
+void MetricsRegistry::addJob(JobHandle job, const char* name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++jobsStarted;
+    jobs.push_back(Entry{job, name != nullptr ? name : "job-" + std::to_string(jobsStarted)});
+}
+
+void MetricsRegistry::removeJob(JobHandle job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [job](const Entry& entry) {
+        return entry.job == job;
+    }), jobs.end());
+}
+
+std::string MetricsRegistry::scrape() const {
+    std::vector<JobSnapshot> snapshots;
+    size_t started;
+    {
+        // The lock keeps every job's handle open while it is read
+        std::lock_guard<std::mutex> lock(mutex);
+        started = jobsStarted;
+        snapshots.reserve(jobs.size());
+        for (const Entry& entry : jobs) {
+            JobSnapshot snapshot{"job=\"" + escapeLabel(entry.name) + "\"", {}, {}, {}, false};
+            getJobState(entry.job, &snapshot.state);
+            getJobStats(entry.job, &snapshot.stats);
+            getJobMetrics(entry.job, &snapshot.metrics);
+            JobError error;
+            snapshot.failed = getJobError(entry.job, &error);
+            snapshots.push_back(std::move(snapshot));
+        }
+    }
+
+    std::string out;
+    writeFamily(out, "mapreduce_jobs_started_total", "counter", "Jobs registered since the registry was created.");
+    writeSample(out, "mapreduce_jobs_started_total", "", static_cast<double>(started));
+    writeFamily(out, "mapreduce_jobs_running", "gauge", "Registered jobs which are not done.");
+    writeSample(out, "mapreduce_jobs_running", "", static_cast<double>(std::count_if(
+        snapshots.begin(), snapshots.end(), [](const JobSnapshot& job) { return !isDone(job.state); })));
+
+    writeJobFamily(out, snapshots, "mapreduce_job_stage", "gauge",
+                   "The current stage of the job (0 undefined, 1 map, 2 shuffle, 3 reduce).",
+                   [](const JobSnapshot& job) { return job.state.stage; });
+    writeJobFamily(out, snapshots, "mapreduce_job_stage_progress_ratio", "gauge",
+                   "The completed fraction of the current stage.",
+                   [](const JobSnapshot& job) { return job.state.percentage / MAX_PERCENTAGE; });
+    writeJobFamily(out, snapshots, "mapreduce_job_failed", "gauge",
+                   "Whether the job failed with an error.",
+                   [](const JobSnapshot& job) { return job.failed; });
+
+    writeFamily(out, "mapreduce_job_processed", "gauge",
+                "Elements processed in every stage of the current run: input pairs in map, "
+                "intermediate pairs in shuffle, groups (or pairs, when streaming) in reduce.");
+    static constexpr std::pair<stage_t, const char*> STAGES[] = {
+        {MAP_STAGE, "map"}, {SHUFFLE_STAGE, "shuffle"}, {REDUCE_STAGE, "reduce"}};
+    for (const JobSnapshot& job : snapshots) {
+        for (const auto& [stage, stageName] : STAGES) {
+            writeSample(out, "mapreduce_job_processed",
+                        job.labels + ",stage=\"" + stageName + "\"",
+                        static_cast<double>(job.metrics.processed[stage]));
+        }
+    }
+
+    writeFamily(out, "mapreduce_job_queue_depth", "gauge",
+                "Work waiting in the job's queues: unclaimed input pairs, output pairs not yet "
+                "polled, and blocking calls waiting for or running on the I/O threads.");
+    for (const JobSnapshot& job : snapshots) {
+        writeSample(out, "mapreduce_job_queue_depth", job.labels + ",queue=\"map_tasks\"",
+                    static_cast<double>(job.metrics.pendingMapTasks));
+        writeSample(out, "mapreduce_job_queue_depth", job.labels + ",queue=\"output\"",
+                    static_cast<double>(job.metrics.pendingOutputPairs));
+        writeSample(out, "mapreduce_job_queue_depth", job.labels + ",queue=\"io_calls\"",
+                    static_cast<double>(job.metrics.pendingIoCalls));
+    }
+
+    writeJobFamily(out, snapshots, "mapreduce_job_barrier_waits", "gauge",
+                   "Times a worker blocked at a barrier waiting for the other workers in the current run.",
+                   [](const JobSnapshot& job) { return job.metrics.barrierWaits; });
+    writeJobFamily(out, snapshots, "mapreduce_job_barrier_wait_seconds", "gauge",
+                   "Time the workers spent blocked at barriers in the current run.",
+                   [](const JobSnapshot& job) { return static_cast<double>(job.metrics.barrierWaitNanos) / 1e9; });
+    writeJobFamily(out, snapshots, "mapreduce_job_memory_used_bytes", "gauge",
+                   "Bytes the job currently accounts for.",
+                   [](const JobSnapshot& job) { return job.stats.memoryUsedBytes; });
+    writeJobFamily(out, snapshots, "mapreduce_job_memory_high_water_bytes", "gauge",
+                   "The most bytes the job accounted for at once.",
+                   [](const JobSnapshot& job) { return job.stats.memoryHighWaterBytes; });
+    writeJobFamily(out, snapshots, "mapreduce_job_speculative_tasks", "gauge",
+                   "Duplicate map calls run in the current run.",
+                   [](const JobSnapshot& job) { return job.stats.speculativeTasks; });
+    writeJobFamily(out, snapshots, "mapreduce_job_retried_map_calls", "gauge",
+                   "Map calls retried after throwing in the current run.",
+                   [](const JobSnapshot& job) { return job.stats.retriedMapCalls; });
+    writeJobFamily(out, snapshots, "mapreduce_job_failed_map_inputs", "gauge",
+                   "Input pairs whose map failed on every attempt.",
+                   [](const JobSnapshot& job) { return job.stats.failedMapInputs; });
+    return out;
+}
+
+bool MetricsRegistry::serve(const int port) {
+    std::lock_guard<std::mutex> lock(serveMutex);
+    if (listenFd != -1) {
+        return false; // Already serving
+    }
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return false;
+    }
+    const int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // Local scrapers only
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    socklen_t length = sizeof(address);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(fd, LISTEN_BACKLOG) != 0 ||
+        getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        close(fd);
+        return false;
+    }
+    listenFd = fd;
+    listenPort.store(ntohs(address.sin_port), std::memory_order_relaxed);
+    stopping.store(false, std::memory_order_relaxed);
+    try {
+        listener = std::thread([this] { listen(); });
+    } catch (const std::system_error&) {
+        close(fd);
+        listenFd = -1;
+        listenPort.store(0, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void MetricsRegistry::stopServing() {
+    std::lock_guard<std::mutex> lock(serveMutex);
+    if (listenFd == -1) {
+        return;
+    }
+    stopping.store(true, std::memory_order_relaxed);
+    listener.join(); // The listener notices within LISTEN_POLL_MS
+    close(listenFd);
+    listenFd = -1;
+    listenPort.store(0, std::memory_order_relaxed);
+}
+
+int MetricsRegistry::port() const {
+    return listenPort.load(std::memory_order_relaxed);
+}
+
+void MetricsRegistry::listen() {
+    pollfd listening{listenFd, POLLIN, 0};
+    while (!stopping.load(std::memory_order_relaxed)) {
+        if (poll(&listening, 1, LISTEN_POLL_MS) <= 0) {
+            continue;
+        }
+        const int connection = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (connection == -1) {
+            continue;
+        }
+        answer(connection);
+        close(connection);
+    }
+}
+
+void MetricsRegistry::answer(const int connection) const {
+    // Read the request up to the end of its headers, whose content does not matter
+    std::string request;
+    pollfd readable{connection, POLLIN, 0};
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST_BYTES) {
+        if (poll(&readable, 1, REQUEST_TIMEOUT_MS) <= 0) {
+            return;
+        }
+        const ssize_t received = recv(connection, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            return;
+        }
+        request.append(buffer, static_cast<size_t>(received));
+    }
+
+    const bool isGet = request.compare(0, 4, "GET ") == 0;
+    const std::string body = isGet ? scrape() : "Only GET is supported\n";
+    std::string response = isGet ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 405 Method Not Allowed\r\n";
+    response += "Content-Type: " METRICS_CONTENT_TYPE "\r\n";
+    response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    response += "Connection: close\r\n\r\n";
+    response += body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        const ssize_t written = send(connection, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (written <= 0) {
+            return;
+        }
+        sent += static_cast<size_t>(written);
+    }
+}
@@ -0,0 +1,60 @@
+#include "../include/OutputQueue.h"
+
+OutputQueue::OutputQueue() : tail(nullptr), head(new OutputChunk()), pendingPairs(0) {
+    // The queue always holds a drained chunk at its head, so pushing never sees an empty queue
+    tail.store(head, std::memory_order_relaxed);
+}
+
+OutputQueue::~OutputQueue() {
+    while (head != nullptr) {
+        OutputChunk* next = head->next.load(std::memory_order_acquire);
+        delete head;
+        head = next;
+    }
+}
+
+void OutputQueue::emit(OutputChunk*& chunk, K3* key, V3* value) {
+    if (chunk == nullptr) {
+        chunk = new OutputChunk();
+    }
+    chunk->pairs[chunk->size++] = {key, value};
+    if (chunk->size == OUTPUT_CHUNK_CAPACITY) {
+        push(chunk);
+        chunk = nullptr; // The next emit starts a new chunk
+    }
+}
+
+void OutputQueue::flush(OutputChunk*& chunk) {
+    if (chunk != nullptr) {
+        push(chunk);
+        chunk = nullptr;
+    }
+}
+
+void OutputQueue::push(OutputChunk* chunk) {
+    chunk->next.store(nullptr, std::memory_order_relaxed);
+    pendingPairs.fetch_add(chunk->size, std::memory_order_relaxed);
+    // Claim the tail, then link the previous tail to the new chunk.
+    // Until the link is stored, the consumer simply does not see the new chunk yet.
+    OutputChunk* prev = tail.exchange(chunk, std::memory_order_acq_rel);
+    prev->next.store(chunk, std::memory_order_release);
+}
+
+size_t OutputQueue::drain(OutputVec& out) {
+    size_t drained = 0;
+    OutputChunk* next = head->next.load(std::memory_order_acquire);
+    while (next != nullptr) {
+        out.insert(out.end(), next->pairs, next->pairs + next->size);
+        drained += next->size;
+        // The drained chunk becomes the new head, and the previous head is no longer reachable
+        delete head;
+        head = next;
+        next = head->next.load(std::memory_order_acquire);
+    }
+    pendingPairs.fetch_sub(drained, std::memory_order_relaxed);
+    return drained;
+}
+
+size_t OutputQueue::pending() const {
+    return pendingPairs.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,127 @@
+#include "../include/PerfCounters.h"
+
+#include <chrono>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * The perf_event_attr type and config of every event, in PERF_EVENT_* bit order.
+ */
+static constexpr std::array<std::pair<uint32_t, uint64_t>, PERF_EVENTS> EVENT_CONFIGS{{
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+}};
+
+/**
+ * Opens a counter of a single event for the calling thread, on any CPU.
+ * @param type The perf_event_attr type of the event.
+ * @param config The perf_event_attr config of the event.
+ * @return The file descriptor of the counter, or -1 if it cannot be opened.
+ */
+static int openCounter(const uint32_t type, const uint64_t config) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1; // Allowed by the default perf_event_paranoid, and blocking is not work
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+#endif
+
+/**
+ * Reads the wall clock for the phases.
+ * @return The steady_clock time in nanoseconds.
+ */
+static int64_t nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+PerfCounters::PerfCounters(const bool enabled) : startValues(), measuring(enabled), startTime(0) {
+    fds.fill(-1);
+#ifdef __linux__
+    if (enabled) {
+        for (int i = 0; i < PERF_EVENTS; ++i) {
+            fds[i] = openCounter(EVENT_CONFIGS[i].first, EVENT_CONFIGS[i].second);
+        }
+    }
+#else
+    (void) enabled; // No perf_event_open, so no event is ever counted
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (const int fd : fds) {
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+#endif
+}
+
+unsigned PerfCounters::available() const {
+    unsigned events = 0;
+    for (int i = 0; i < PERF_EVENTS; ++i) {
+        if (fds[i] != -1) {
+            events |= 1u << i;
+        }
+    }
+    return events;
+}
+
+void PerfCounters::read(std::array<uint64_t, PERF_EVENTS>& values) const {
+    values.fill(0);
+#ifdef __linux__
+    for (int i = 0; i < PERF_EVENTS; ++i) {
+        uint64_t data[3]; // The value, the time enabled and the time running
+        if (fds[i] == -1 || ::read(fds[i], data, sizeof(data)) != sizeof(data)) {
+            continue;
+        }
+        values[i] = data[2] == 0 || data[2] >= data[1]
+            ? data[0]
+            : static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+    }
+#endif
+}
+
+bool PerfCounters::enabled() const {
+    return measuring;
+}
+
+void PerfCounters::start() {
+    if (!measuring) {
+        return;
+    }
+    if (available() != 0) {
+        read(startValues);
+    }
+    startTime = nowNanos();
+}
+
+void PerfCounters::stop(PhaseCounters& counters) {
+    if (!measuring) {
+        return;
+    }
+    counters.nanos += static_cast<uint64_t>(nowNanos() - startTime);
+    if (available() == 0) {
+        return;
+    }
+    std::array<uint64_t, PERF_EVENTS> values;
+    read(values);
+    for (int i = 0; i < PERF_EVENTS; ++i) {
+        // Scaled values are estimates, so a multiplexed counter may seem to go back a little
+        values[i] = values[i] > startValues[i] ? values[i] - startValues[i] : 0;
+    }
+    counters.cycles += values[0];
+    counters.instructions += values[1];
+    counters.cacheMisses += values[2];
+    counters.branchMisses += values[3];
+}
@@ -0,0 +1,300 @@
+#include "../include/SegmentedBuffer.h"
+
+#include <algorithm>
+#include <new>
+#include <utility>
+
+#define INSERTION_SORT_MAX 16 // Ranges of at most this many pairs are sorted by insertion
+
+SegmentPool::SegmentPool(const size_t maxCached) : maxCached(maxCached) {}
+
+SegmentPool& SegmentPool::instance() {
+    static SegmentPool pool(SEGMENT_POOL_MAX_CACHED);
+    return pool;
+}
+
+IntermediatePair* SegmentPool::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!freeSegments.empty()) {
+            IntermediatePair* segment = freeSegments.back();
+            freeSegments.pop_back();
+            return segment;
+        }
+    }
+    // Allocate outside the lock, the pool is empty anyway
+    return static_cast<IntermediatePair*>(::operator new(SEGMENT_BYTES));
+}
+
+void SegmentPool::release(IntermediatePair* segment) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (freeSegments.size() < maxCached) {
+            freeSegments.push_back(segment);
+            return;
+        }
+    }
+    ::operator delete(segment);
+}
+
+SegmentPool::~SegmentPool() {
+    for (IntermediatePair* segment : freeSegments) {
+        ::operator delete(segment);
+    }
+}
+
+SegmentedBuffer::SegmentedBuffer(SegmentPool* pool) : pool(pool) {}
+
+SegmentedBuffer::~SegmentedBuffer() {
+    clear();
+}
+
+SegmentedBuffer::SegmentedBuffer(SegmentedBuffer&& other) noexcept
+    : pool(other.pool), segments(std::move(other.segments)), count(other.count) {
+    other.segments.clear();
+    other.count = 0;
+}
+
+SegmentedBuffer& SegmentedBuffer::operator=(SegmentedBuffer&& other) noexcept {
+    if (this != &other) {
+        clear();
+        pool = other.pool;
+        segments = std::move(other.segments);
+        count = other.count;
+        other.segments.clear();
+        other.count = 0;
+    }
+    return *this;
+}
+
+void SegmentedBuffer::emplace_back(K2* key, V2* value) {
+    if (count == segments.size() * SEGMENT_CAPACITY) {
+        segments.push_back(pool->acquire()); // The last segment is full
+    }
+    // The segment's storage is raw memory, so the pair is constructed in place
+    new (&segments[count / SEGMENT_CAPACITY][count % SEGMENT_CAPACITY]) IntermediatePair(key, value);
+    ++count;
+}
+
+const IntermediatePair& SegmentedBuffer::back() const {
+    return (*this)[count - 1];
+}
+
+void SegmentedBuffer::pop_back() {
+    --count;
+    if (count % SEGMENT_CAPACITY == 0) {
+        trim(); // The last segment is now empty
+    }
+}
+
+const IntermediatePair& SegmentedBuffer::operator[](const size_t index) const {
+    return segments[index / SEGMENT_CAPACITY][index % SEGMENT_CAPACITY];
+}
+
+size_t SegmentedBuffer::size() const {
+    return count;
+}
+
+bool SegmentedBuffer::empty() const {
+    return count == 0;
+}
+
+size_t SegmentedBuffer::capacity() const {
+    return segments.size() * SEGMENT_CAPACITY;
+}
+
+void SegmentedBuffer::reserve(const size_t capacity) {
+    while (segments.size() * SEGMENT_CAPACITY < capacity) {
+        segments.push_back(pool->acquire());
+    }
+}
+
+void SegmentedBuffer::clear() {
+    count = 0;
+    trim();
+}
+
+void SegmentedBuffer::trim() {
+    const size_t needed = (count + SEGMENT_CAPACITY - 1) / SEGMENT_CAPACITY;
+    while (segments.size() > needed) {
+        pool->release(segments.back());
+        segments.pop_back();
+    }
+}
+
+namespace {
+
+/**
+ * @return true if the key of the first pair is less than the key of the second.
+ */
+bool lessByKey(const IntermediatePair& a, const IntermediatePair& b) {
+    return *a.first < *b.first;
+}
+
+/**
+ * Sorts a short range of pairs by key, by insertion.
+ */
+void insertionSort(IntermediatePair* first, IntermediatePair* last) {
+    for (IntermediatePair* i = first + 1; i < last; ++i) {
+        for (IntermediatePair* j = i; j > first && lessByKey(*j, *(j - 1)); --j) {
+            std::swap(*j, *(j - 1));
+        }
+    }
+}
+
+/**
+ * Moves the pair at the given position of a max-heap down to its place.
+ */
+void siftDown(IntermediatePair* first, size_t root, const size_t size) {
+    while (true) {
+        size_t child = 2 * root + 1;
+        if (child >= size) {
+            return;
+        }
+        if (child + 1 < size && lessByKey(first[child], first[child + 1])) {
+            ++child;
+        }
+        if (!lessByKey(first[root], first[child])) {
+            return;
+        }
+        std::swap(first[root], first[child]);
+        root = child;
+    }
+}
+
+/**
+ * Sorts a range of pairs by key, by heapsort.
+ */
+void heapSort(IntermediatePair* first, IntermediatePair* last) {
+    const auto size = static_cast<size_t>(last - first);
+    for (size_t root = size / 2; root-- > 0;) {
+        siftDown(first, root, size);
+    }
+    for (size_t end = size; end-- > 1;) {
+        std::swap(first[0], first[end]);
+        siftDown(first, 0, end);
+    }
+}
+
+/**
+ * Sorts a range of pairs by key in place (introsort).
+ *
+ * Pairs are only ever moved by swapping them, so if a comparison throws, the range still holds
+ * all its pairs, in some order. std::sort gives no such guarantee, since it holds pairs aside.
+ * @param first The first pair of the range.
+ * @param last The end of the range.
+ * @param depth The partitioning depth left before falling back to heapsort.
+ */
+void sortByKey(IntermediatePair* first, IntermediatePair* last, int depth) {
+    while (last - first > INSERTION_SORT_MAX) {
+        if (depth-- == 0) {
+            heapSort(first, last);
+            return;
+        }
+        // Order the first, middle and last pairs, and move their median to the front as the pivot
+        IntermediatePair* middle = first + (last - first) / 2;
+        if (lessByKey(*middle, *first)) {
+            std::swap(*middle, *first);
+        }
+        if (lessByKey(*(last - 1), *middle)) {
+            std::swap(*(last - 1), *middle);
+            if (lessByKey(*middle, *first)) {
+                std::swap(*middle, *first);
+            }
+        }
+        std::swap(*first, *middle);
+
+        // The last pair is not less than the pivot and the pivot is not less than itself,
+        // so both scans stop within the range
+        IntermediatePair* low = first + 1;
+        IntermediatePair* high = last;
+        while (true) {
+            while (lessByKey(*low, *first)) {
+                ++low;
+            }
+            --high;
+            while (lessByKey(*first, *high)) {
+                --high;
+            }
+            if (low >= high) {
+                break;
+            }
+            std::swap(*low, *high);
+            ++low;
+        }
+        sortByKey(low, last, depth);
+        last = low;
+    }
+    insertionSort(first, last);
+}
+
+} // namespace
+
+void SegmentedBuffer::sort() {
+    trim(); // Reserved segments take no part in the sort
+
+    // First, sort every segment on its own, in place
+    int depth = 0;
+    for (size_t size = SEGMENT_CAPACITY; size > 1; size /= 2) {
+        depth += 2;
+    }
+    for (size_t i = 0; i < segments.size(); ++i) {
+        const size_t segmentSize = std::min<size_t>(SEGMENT_CAPACITY, count - i * SEGMENT_CAPACITY);
+        sortByKey(segments[i], segments[i] + segmentSize, depth);
+    }
+    if (segments.size() <= 1) {
+        return; // A single sorted segment is already the sorted buffer
+    }
+
+    // Then, merge the sorted segments into new ones using a heap of their heads (smallest key on top)
+    // The heap only holds the indices of the runs, so if a comparison throws while it is being
+    // reordered, the runs themselves still tell which pairs were not merged yet
+    struct Run {
+        IntermediatePair* head;
+        IntermediatePair* end;
+    };
+    std::vector<Run> runs;
+    std::vector<size_t> heap;
+    runs.reserve(segments.size());
+    heap.reserve(segments.size());
+    for (size_t i = 0; i < segments.size(); ++i) {
+        const size_t segmentSize = std::min<size_t>(SEGMENT_CAPACITY, count - i * SEGMENT_CAPACITY);
+        runs.push_back({segments[i], segments[i] + segmentSize});
+        heap.push_back(i);
+    }
+    const auto greaterHead = [&runs](const size_t a, const size_t b) {
+        return lessByKey(*runs[b].head, *runs[a].head);
+    };
+
+    // Every segment is returned to the pool as soon as it is fully merged
+    std::vector<IntermediatePair*> sources;
+    sources.swap(segments);
+    count = 0;
+    try {
+        std::make_heap(heap.begin(), heap.end(), greaterHead);
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), greaterHead);
+            const size_t index = heap.back();
+            Run& run = runs[index];
+            emplace_back(run.head->first, run.head->second);
+            if (++run.head == run.end) {
+                heap.pop_back();
+                pool->release(sources[index]);
+                sources[index] = nullptr;
+            } else {
+                std::push_heap(heap.begin(), heap.end(), greaterHead);
+            }
+        }
+    } catch (...) {
+        // The pairs not merged yet follow the merged ones, so the buffer still holds all its pairs
+        for (size_t i = 0; i < runs.size(); ++i) {
+            for (const IntermediatePair* pair = runs[i].head; pair != runs[i].end; ++pair) {
+                emplace_back(pair->first, pair->second);
+            }
+            if (sources[i] != nullptr) {
+                pool->release(sources[i]);
+            }
+        }
+        throw;
+    }
+}
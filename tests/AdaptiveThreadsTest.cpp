@@ -0,0 +1,67 @@
+/**
+ * Tests of the adaptive thread count, which searches for the best number of active workers in
+ * every phase.
+ */
+#include "TestUtil.h"
+
+#define ADAPTIVE_THREADS 8 // The most workers of the adaptive jobs
+#define ADAPTIVE_INPUT_SIZE 1000 // Enough input pairs for the level to be measured and adapted
+
+/**
+ * Tests adaptive jobs in every reduce mode: their output must be complete, and the levels they
+ * chose must be within the job's thread count.
+ */
+static bool testAdaptiveLevels() {
+    const SumClient client;
+    for (const bool streaming : {false, true}) {
+        JobConfig config;
+        config.multiThreadLevel = ADAPTIVE_THREADS;
+        config.streamingReduce = streaming;
+        config.adaptiveThreads = true;
+        InputVec input = makeInput(ADAPTIVE_INPUT_SIZE);
+        OutputVec output;
+        JobHandle job = startMapReduceJob(client, input, output, config);
+        waitForJob(job);
+        JobStats stats;
+        getJobStats(job, &stats);
+        closeJobHandle(job);
+        freeInput(input);
+        CHECK(stats.mapThreads >= 1 && stats.mapThreads <= ADAPTIVE_THREADS);
+        CHECK(stats.reduceThreads >= 1 && stats.reduceThreads <= ADAPTIVE_THREADS);
+        CHECK(checkSums(output, ADAPTIVE_INPUT_SIZE));
+        CHECK(liveObjects.load() == 0);
+    }
+    return true;
+}
+
+/**
+ * Tests that all the workers run every phase of a job that is not adaptive, and of a
+ * deterministic job, which ignores adaptiveThreads.
+ */
+static bool testFixedLevels() {
+    const SumClient client;
+    for (const bool adaptive : {false, true}) {
+        JobConfig config;
+        config.multiThreadLevel = ADAPTIVE_THREADS;
+        config.adaptiveThreads = adaptive;
+        config.deterministic = adaptive;
+        InputVec input = makeInput(INPUT_SIZE);
+        OutputVec output;
+        JobHandle job = startMapReduceJob(client, input, output, config);
+        waitForJob(job);
+        JobStats stats;
+        getJobStats(job, &stats);
+        closeJobHandle(job);
+        freeInput(input);
+        CHECK(stats.mapThreads == ADAPTIVE_THREADS && stats.reduceThreads == ADAPTIVE_THREADS);
+        CHECK(checkSums(output, INPUT_SIZE));
+    }
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"adaptive levels", testAdaptiveLevels},
+        {"fixed levels", testFixedLevels},
+    });
+}
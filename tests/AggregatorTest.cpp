@@ -0,0 +1,191 @@
+/**
+ * Tests of the built-in aggregations of an AggregatingClient, which the framework folds while
+ * merging the intermediate vectors instead of calling reduce.
+ */
+#include <algorithm>
+#include <map>
+#include "TestUtil.h"
+#include "../include/Aggregators.h"
+
+/**
+ * A floating point output value.
+ */
+class DoubleValue final : public V3, public Counted {
+public:
+    explicit DoubleValue(const double value) : value(value) {}
+
+    double value;
+};
+
+/**
+ * An aggregating client which emits the pairs (i % KEYS, i) for every i below the input value.
+ */
+class AggregateClient final : public AggregatingClient {
+public:
+    /**
+     * @param kind The aggregation.
+     * @param throwingEmit Whether the emitAggregate of THROWING_REDUCE_KEY throws.
+     */
+    explicit AggregateClient(const aggregate_t kind, const bool throwingEmit = false)
+        : kind(kind), throwingEmit(throwingEmit) {}
+
+    [[nodiscard]] aggregate_t aggregate() const override {
+        return kind;
+    }
+
+    void map(const K1*, const V1* value, void* context) const override {
+        const long n = static_cast<const IntValue*>(value)->value;
+        for (long i = 0; i < n; ++i) {
+            emit2(new IntKey(static_cast<int>(i % KEYS)), new NumericValue(static_cast<double>(i)), context);
+        }
+    }
+
+    void emitAggregate(K2* key, const double result, void* context) const override {
+        if (throwingEmit && static_cast<IntKey*>(key)->value == THROWING_REDUCE_KEY) {
+            delete key; // The key was handed over, so it is released before throwing
+            throw std::runtime_error("throwing emit");
+        }
+        emit3(static_cast<IntKey*>(key), new DoubleValue(result), context);
+    }
+
+    void releaseIntermediate(K2* key, V2* value) const override {
+        delete key;
+        delete value;
+    }
+
+private:
+    const aggregate_t kind;
+    const bool throwingEmit;
+};
+
+/**
+ * Computes the expected output of an AggregateClient job.
+ * @param kind The aggregation.
+ * @param size The number of input pairs.
+ * @return The aggregated value of every key.
+ */
+static std::map<int, double> expectedAggregates(const aggregate_t kind, const int size) {
+    std::map<int, double> sums;
+    std::map<int, double> counts;
+    std::map<int, double> mins;
+    std::map<int, double> maxs;
+    for (int n = 0; n < size; ++n) {
+        for (int i = 0; i < n; ++i) {
+            const int key = i % KEYS;
+            sums[key] += i;
+            counts[key] += 1;
+            mins[key] = mins.count(key) == 0 ? i : std::min(mins[key], static_cast<double>(i));
+            maxs[key] = maxs.count(key) == 0 ? i : std::max(maxs[key], static_cast<double>(i));
+        }
+    }
+    switch (kind) {
+        case AGGREGATE_SUM:
+            return sums;
+        case AGGREGATE_COUNT:
+            return counts;
+        case AGGREGATE_MIN:
+            return mins;
+        case AGGREGATE_MAX:
+            return maxs;
+        default:
+            for (auto& [key, sum] : sums) {
+                sum /= counts[key];
+            }
+            return sums;
+    }
+}
+
+/**
+ * Runs an AggregateClient job, checks its output and frees it.
+ * @param kind The aggregation.
+ * @param config The configuration of the job.
+ * @return true if every key has its expected aggregate and no pair was leaked, false otherwise.
+ */
+static bool checkAggregateJob(const aggregate_t kind, const JobConfig& config) {
+    const AggregateClient client(kind);
+    InputVec input = makeInput(INPUT_SIZE);
+    OutputVec output;
+    JobHandle job = startMapReduceJob(client, input, output, config);
+    closeJobHandle(job);
+    freeInput(input);
+    std::map<int, double> actual;
+    for (const auto& [key, value] : output) {
+        actual[static_cast<const IntKey*>(key)->value] = static_cast<const DoubleValue*>(value)->value;
+        delete static_cast<IntKey*>(key);
+        delete static_cast<DoubleValue*>(value);
+    }
+    CHECK(output.size() == KEYS);
+    CHECK(actual == expectedAggregates(kind, INPUT_SIZE));
+    CHECK(liveObjects.load() == 0);
+    return true;
+}
+
+/**
+ * Tests every aggregation, folded in the shuffle and, in streaming mode, straight from the merge.
+ */
+static bool testAggregations() {
+    for (const aggregate_t kind : {AGGREGATE_SUM, AGGREGATE_COUNT, AGGREGATE_MIN, AGGREGATE_MAX, AGGREGATE_AVG}) {
+        for (const int threads : {1, THREADS}) {
+            for (const bool streaming : {false, true}) {
+                JobConfig config;
+                config.multiThreadLevel = threads;
+                config.streamingReduce = streaming;
+                CHECK(checkAggregateJob(kind, config));
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Tests aggregating jobs whose emitAggregate throws, in every reduce mode: the groups that were
+ * not emitted, and in streaming mode the pairs not folded yet, must all be released.
+ */
+static bool testThrowingEmit() {
+    const AggregateClient client(AGGREGATE_SUM, true);
+    for (const bool streaming : {false, true}) {
+        JobConfig config;
+        config.multiThreadLevel = THREADS;
+        config.streamingReduce = streaming;
+        InputVec input = makeInput(INPUT_SIZE);
+        OutputVec output;
+        JobHandle job = startMapReduceJob(client, input, output, config);
+        waitForJob(job);
+        JobError error;
+        const bool failed = getJobError(job, &error);
+        closeJobHandle(job);
+        freeInput(input);
+        for (const auto& [key, value] : output) { // Whatever was emitted before the error
+            delete static_cast<IntKey*>(key);
+            delete static_cast<DoubleValue*>(value);
+        }
+        CHECK(failed && error.stage == REDUCE_STAGE);
+        CHECK(liveObjects.load() == 0);
+    }
+    return true;
+}
+
+/**
+ * Tests the aggregate of a group with no values, and of a single value.
+ */
+static bool testAggregate() {
+    const Aggregate empty;
+    CHECK(empty.count() == 0);
+    CHECK(empty.result(AGGREGATE_AVG) == 0 && empty.result(AGGREGATE_MIN) == 0);
+    Aggregate single;
+    single.add(-2.5);
+    CHECK(single.count() == 1);
+    for (const aggregate_t kind : {AGGREGATE_SUM, AGGREGATE_MIN, AGGREGATE_MAX, AGGREGATE_AVG}) {
+        CHECK(single.result(kind) == -2.5);
+    }
+    CHECK(single.result(AGGREGATE_COUNT) == 1);
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"aggregations", testAggregations},
+        {"throwing emit", testThrowingEmit},
+        {"aggregate", testAggregate},
+    });
+}
@@ -0,0 +1,171 @@
+/**
+ * Tests of the asynchronous map tasks, whose blocking calls run on the job's I/O threads while
+ * the workers go on with other tasks.
+ */
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include "TestUtil.h"
+#include "../include/AsyncMap.h"
+
+#define ASYNC_INPUT_SIZE 40 // Input pairs of the async jobs, each waiting for a blocking call
+#define BLOCKING_CALL_MS 5 // The duration of every blocking call
+#define THROWING_INPUT 7 // The input value whose blocking call throws
+
+/**
+ * An async client which waits for a blocking call before emitting the pairs of SumClient, and
+ * records how many of its blocking calls ran at once.
+ */
+class AsyncSumClient final : public AsyncMapReduceClient {
+public:
+    /**
+     * @param throwing Whether the blocking call of THROWING_INPUT throws.
+     */
+    explicit AsyncSumClient(const bool throwing = false) : throwing(throwing) {}
+
+    MapTask mapAsync(const K1*, const V1* value, void* context) const override {
+        const long n = static_cast<const IntValue*>(value)->value;
+        co_await BlockingCall([this, n] {
+            const int running = ++runningCalls;
+            int seen = maxRunningCalls.load();
+            while (running > seen && !maxRunningCalls.compare_exchange_weak(seen, running)) {}
+            std::this_thread::sleep_for(std::chrono::milliseconds(BLOCKING_CALL_MS));
+            --runningCalls;
+            if (throwing && n == THROWING_INPUT) {
+                throw std::runtime_error("throwing call");
+            }
+        }, context);
+        for (long i = 0; i < n; ++i) {
+            emit2(new IntKey(static_cast<int>(i % KEYS)), new IntValue(i), context);
+        }
+    }
+
+    void reduce(const IntermediateVec* pairs, void* context) const override {
+        auto* key = static_cast<IntKey*>(pairs->front().first);
+        long sum = 0;
+        for (const auto& [pairKey, pairValue] : *pairs) {
+            sum += static_cast<IntValue*>(pairValue)->value;
+            if (pairKey != key) {
+                delete pairKey;
+            }
+            delete pairValue;
+        }
+        emit3(key, new IntValue(sum), context);
+    }
+
+    void releaseIntermediate(K2* key, V2* value) const override {
+        delete key;
+        delete value;
+    }
+
+    mutable std::atomic<int> runningCalls{0}; // Blocking calls running now
+    mutable std::atomic<int> maxRunningCalls{0}; // Most blocking calls that ran at once
+
+private:
+    const bool throwing;
+};
+
+/**
+ * Tests that the output of async jobs is complete in every mode, and that the blocking calls of
+ * a single worker overlap on the I/O threads.
+ */
+static bool testAsyncOutput() {
+    for (const bool deterministic : {false, true}) {
+        for (const bool streaming : {false, true}) {
+            const AsyncSumClient client;
+            JobConfig config;
+            config.multiThreadLevel = 1;
+            config.deterministic = deterministic;
+            config.streamingReduce = streaming;
+            InputVec input = makeInput(ASYNC_INPUT_SIZE);
+            OutputVec output;
+            JobHandle job = startMapReduceJob(client, input, output, config);
+            waitForJob(job);
+            JobMetrics metrics;
+            getJobMetrics(job, &metrics);
+            closeJobHandle(job);
+            freeInput(input);
+            CHECK(metrics.pendingIoCalls == 0);
+            CHECK(checkSums(output, ASYNC_INPUT_SIZE));
+            CHECK(liveObjects.load() == 0);
+            // A deterministic worker runs its tasks one at a time
+            CHECK(deterministic ? client.maxRunningCalls == 1 : client.maxRunningCalls > 1);
+            CHECK(client.maxRunningCalls <= std::min(config.asyncIoThreads, config.asyncTasksPerWorker));
+        }
+    }
+    return true;
+}
+
+/**
+ * Tests an async job whose blocking call throws: the exception must fail the job in the map stage
+ * once it is rethrown in the task, and all the pairs must be released.
+ */
+static bool testThrowingCall() {
+    const AsyncSumClient client(true);
+    JobConfig config;
+    config.multiThreadLevel = THREADS;
+    InputVec input = makeInput(ASYNC_INPUT_SIZE);
+    OutputVec output;
+    JobHandle job = startMapReduceJob(client, input, output, config);
+    waitForJob(job);
+    JobError error;
+    const bool failed = getJobError(job, &error);
+    closeJobHandle(job);
+    freeInput(input);
+    freeOutput(output);
+    CHECK(failed && error.stage == MAP_STAGE && error.taskIndex == THROWING_INPUT);
+    try {
+        std::rethrow_exception(error.exception);
+    } catch (const std::runtime_error& e) {
+        CHECK(std::string(e.what()) == "throwing call");
+    }
+    CHECK(liveObjects.load() == 0);
+    return true;
+}
+
+/**
+ * A plain client which calls the map of an async client, as code unaware of async clients would.
+ */
+class SyncClient final : public MapReduceClient {
+public:
+    explicit SyncClient(const AsyncSumClient& async) : async(async) {}
+
+    void map(const K1* key, const V1* value, void* context) const override {
+        async.map(key, value, context);
+    }
+
+    void reduce(const IntermediateVec* pairs, void* context) const override {
+        async.reduce(pairs, context);
+    }
+
+private:
+    const AsyncSumClient& async;
+};
+
+/**
+ * Tests an async client used like any other, through map, which runs the blocking calls in place.
+ */
+static bool testSyncMap() {
+    const AsyncSumClient client;
+    IntValue value(KEYS + 1);
+    InputVec input = {{nullptr, &value}};
+    OutputVec output;
+    JobConfig config;
+    config.multiThreadLevel = 1;
+    const SyncClient syncClient(client);
+    JobHandle job = startMapReduceJob(syncClient, input, output, config);
+    closeJobHandle(job);
+    CHECK(checkSums(output, 1, KEYS + 1));
+    CHECK(client.maxRunningCalls == 1);
+    CHECK(liveObjects.load() == 1); // Only the input value
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"async output", testAsyncOutput},
+        {"throwing blocking call", testThrowingCall},
+        {"map of an async client", testSyncMap},
+    });
+}
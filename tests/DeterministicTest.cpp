@@ -0,0 +1,126 @@
+/**
+ * Tests of the output of jobs in every mode, and of the deterministic jobs, whose runs on the same
+ * input produce the same output in the same order.
+ */
+#include <vector>
+#include "TestUtil.h"
+
+#define RUNS 3 // Runs of every deterministic job
+
+/**
+ * A client which emits the pairs of SumClient, with a digest of every output pair.
+ */
+class DigestClient final : public MapReduceClient {
+public:
+    void map(const K1* key, const V1* value, void* context) const override {
+        sum.map(key, value, context);
+    }
+
+    void reduce(const IntermediateVec* pairs, void* context) const override {
+        sum.reduce(pairs, context);
+    }
+
+    void releaseIntermediate(K2* key, V2* value) const override {
+        sum.releaseIntermediate(key, value);
+    }
+
+    uint64_t outputDigest(const K3* key, const V3* value) const override {
+        return static_cast<uint64_t>(static_cast<const IntKey*>(key)->value) * 1000003u
+               + static_cast<uint64_t>(static_cast<const IntValue*>(value)->value);
+    }
+
+private:
+    const SumClient sum;
+};
+
+/**
+ * Tests that a job's output is complete in every mode, including the output queue.
+ */
+static bool testOutput() {
+    const SumClient client;
+    for (const bool deterministic : {false, true}) {
+        for (const bool streaming : {false, true}) {
+            for (const bool outputQueue : {false, true}) {
+                JobConfig config;
+                config.multiThreadLevel = THREADS;
+                config.deterministic = deterministic;
+                config.streamingReduce = streaming;
+                config.outputQueue = outputQueue;
+                InputVec input = makeInput(INPUT_SIZE);
+                OutputVec output;
+                JobHandle job = startMapReduceJob(client, input, output, config);
+                waitForJob(job);
+                closeJobHandle(job);
+                freeInput(input);
+                CHECK(checkSums(output, INPUT_SIZE));
+                CHECK(liveObjects.load() == 0);
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Runs a job to completion.
+ * @param config The job's configuration.
+ * @param offset The offset of the input values (see makeInput).
+ * @param digest Set to the job's output digest.
+ * @param order Set to the keys of the output, in order.
+ * @return true if the output is complete, false otherwise.
+ */
+static bool runDigestJob(const JobConfig& config, const int offset, uint64_t& digest, std::vector<int>& order) {
+    const DigestClient client;
+    InputVec input = makeInput(INPUT_SIZE, offset);
+    OutputVec output;
+    JobHandle job = startMapReduceJob(client, input, output, config);
+    waitForJob(job);
+    JobStats stats;
+    getJobStats(job, &stats);
+    closeJobHandle(job);
+    freeInput(input);
+    order.clear();
+    for (const auto& [key, value] : output) {
+        order.push_back(static_cast<const IntKey*>(key)->value);
+    }
+    digest = stats.outputDigest;
+    return checkSums(output, INPUT_SIZE, offset);
+}
+
+/**
+ * Tests deterministic jobs in every reduce mode: their runs on the same input must produce the
+ * same output order and digest, and a run on another input another digest. A job that is not
+ * deterministic has no digest.
+ */
+static bool testDigest() {
+    for (const bool streaming : {false, true}) {
+        JobConfig config;
+        config.multiThreadLevel = THREADS;
+        config.streamingReduce = streaming;
+        config.deterministic = true;
+        uint64_t firstDigest;
+        std::vector<int> firstOrder;
+        CHECK(runDigestJob(config, 0, firstDigest, firstOrder));
+        CHECK(firstDigest != 0 && firstOrder.size() == KEYS);
+        uint64_t digest;
+        std::vector<int> order;
+        for (int run = 1; run < RUNS; ++run) {
+            CHECK(runDigestJob(config, 0, digest, order));
+            CHECK(digest == firstDigest && order == firstOrder);
+        }
+        CHECK(runDigestJob(config, 1, digest, order));
+        CHECK(digest != firstDigest);
+
+        config.deterministic = false;
+        CHECK(runDigestJob(config, 0, digest, order));
+        CHECK(digest == 0);
+        CHECK(liveObjects.load() == 0);
+    }
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"output", testOutput},
+        {"digest", testDigest},
+    });
+}
@@ -0,0 +1,115 @@
+/**
+ * Tests of the fair scheduler, which shares execution slots between the workers of several jobs.
+ */
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "TestUtil.h"
+#include "../include/FairScheduler.h"
+
+#define SLOTS 2 // Slots of the scheduler shared by the test jobs
+#define JOBS 3 // Jobs sharing the scheduler at once
+#define WAIT_MS 50 // Long enough for a thread to block in acquire
+
+/**
+ * A client which emits the pairs of SumClient, and records how many of its map calls (of all
+ * the jobs it runs) run at once.
+ */
+class CountingClient final : public MapReduceClient {
+public:
+    void map(const K1* key, const V1* value, void* context) const override {
+        const int running = ++runningCalls;
+        int seen = maxRunningCalls.load();
+        while (running > seen && !maxRunningCalls.compare_exchange_weak(seen, running)) {}
+        sum.map(key, value, context);
+        --runningCalls;
+    }
+
+    void reduce(const IntermediateVec* pairs, void* context) const override {
+        sum.reduce(pairs, context);
+    }
+
+    void releaseIntermediate(K2* key, V2* value) const override {
+        sum.releaseIntermediate(key, value);
+    }
+
+    mutable std::atomic<int> runningCalls{0}; // Map calls running now
+    mutable std::atomic<int> maxRunningCalls{0}; // Most map calls that ran at once
+
+private:
+    const SumClient sum;
+};
+
+/**
+ * Tests that a free slot goes to the waiting job of the highest priority, whatever the order in
+ * which the jobs started waiting.
+ */
+static bool testPriority() {
+    FairScheduler scheduler(1);
+    const int low = scheduler.addJob(0, 1);
+    const int high = scheduler.addJob(5, 1);
+    std::mutex orderMutex;
+    std::vector<int> order;
+    scheduler.acquire(low);
+    std::vector<std::thread> waiters;
+    for (const int job : {low, high}) {
+        waiters.emplace_back([&, job] {
+            scheduler.acquire(job);
+            {
+                std::lock_guard<std::mutex> lock(orderMutex);
+                order.push_back(job);
+            }
+            scheduler.release(job);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(WAIT_MS));
+    }
+    scheduler.release(low);
+    for (std::thread& waiter : waiters) {
+        waiter.join();
+    }
+    scheduler.removeJob(low);
+    scheduler.removeJob(high);
+    CHECK((order == std::vector<int>{high, low}));
+    return true;
+}
+
+/**
+ * Tests jobs of several priorities and weights sharing a scheduler: their output must be complete,
+ * and no more map calls may run at once than the scheduler has slots, whatever the jobs' thread
+ * counts are.
+ */
+static bool testSharedSlots() {
+    FairScheduler scheduler(SLOTS);
+    const CountingClient client;
+    for (const bool streaming : {false, true}) {
+        std::vector<InputVec> inputs(JOBS);
+        std::vector<OutputVec> outputs(JOBS);
+        std::vector<JobHandle> jobs;
+        for (int i = 0; i < JOBS; ++i) {
+            JobConfig config;
+            config.multiThreadLevel = THREADS;
+            config.streamingReduce = streaming;
+            config.scheduler = &scheduler;
+            config.priority = i % 2;
+            config.weight = i + 1;
+            inputs[i] = makeInput(INPUT_SIZE);
+            jobs.push_back(startMapReduceJob(client, inputs[i], outputs[i], config));
+        }
+        for (int i = 0; i < JOBS; ++i) {
+            closeJobHandle(jobs[i]);
+            freeInput(inputs[i]);
+            CHECK(checkSums(outputs[i], INPUT_SIZE));
+        }
+        CHECK(liveObjects.load() == 0);
+    }
+    CHECK(client.maxRunningCalls <= SLOTS);
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"priority", testPriority},
+        {"shared slots", testSharedSlots},
+    });
+}
@@ -0,0 +1,59 @@
+/**
+ * Tests of the inline jobs, which are small enough for startMapReduceJob to run them on the
+ * calling thread.
+ */
+#include <thread>
+#include "TestUtil.h"
+
+/**
+ * Tests that a job small enough to run inline is run by the calling thread before
+ * startMapReduceJob returns, in every reduce mode.
+ */
+static bool testInlineJob() {
+    for (const bool streaming : {false, true}) {
+        const SumClient client;
+        JobConfig config;
+        config.multiThreadLevel = THREADS;
+        config.streamingReduce = streaming;
+        config.inlineInputPairs = INPUT_SIZE;
+        InputVec input = makeInput(INPUT_SIZE);
+        OutputVec output;
+        JobHandle job = startMapReduceJob(client, input, output, config);
+        CHECK(client.mapThread == std::this_thread::get_id());
+        JobState state;
+        getJobState(job, &state);
+        CHECK(state.stage == REDUCE_STAGE && state.percentage == 100);
+        closeJobHandle(job);
+        freeInput(input);
+        CHECK(checkSums(output, INPUT_SIZE));
+        CHECK(liveObjects.load() == 0);
+    }
+    return true;
+}
+
+/**
+ * Tests that a job with more input pairs than inlineInputPairs is run by worker threads.
+ */
+static bool testLargeJob() {
+    const SumClient client;
+    JobConfig config;
+    config.multiThreadLevel = THREADS;
+    config.inlineInputPairs = INPUT_SIZE - 1;
+    InputVec input = makeInput(INPUT_SIZE);
+    OutputVec output;
+    JobHandle job = startMapReduceJob(client, input, output, config);
+    waitForJob(job);
+    CHECK(client.mapThread != std::this_thread::get_id());
+    closeJobHandle(job);
+    freeInput(input);
+    CHECK(checkSums(output, INPUT_SIZE));
+    CHECK(liveObjects.load() == 0);
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"inline job", testInlineJob},
+        {"large job", testLargeJob},
+    });
+}
@@ -0,0 +1,169 @@
+/**
+ * Tests of the iterative job driver, which runs a reusable job until its client converges,
+ * feeding the output of every iteration back as the next input.
+ */
+#include <map>
+#include <vector>
+#include "TestUtil.h"
+#include "../include/IterativeJob.h"
+
+#define MAX_ITERATIONS 100 // More iterations than HalvingClient needs to converge
+#define THROWING_ITERATION 2 // The iteration in which the reduce of a failing HalvingClient throws
+
+/**
+ * A client which maps every value v to the pair (v % KEYS, v / divisor), with the divisor read
+ * from the broadcast of the iteration, and sums the values of every key. The sums are the input
+ * of the next iteration, until they are all 0.
+ */
+class HalvingClient final : public IterativeClient {
+public:
+    /**
+     * @param throwing Whether the reduce of THROWING_ITERATION throws.
+     */
+    explicit HalvingClient(const bool throwing = false) : throwing(throwing) {}
+
+    [[nodiscard]] const void* broadcast(const int iteration) const override {
+        lastIteration = iteration;
+        return &divisor;
+    }
+
+    void map(const K1*, const V1* value, void* context) const override {
+        const long n = static_cast<const IntValue*>(value)->value;
+        const long d = *static_cast<const long*>(getBroadcast(context));
+        emit2(new IntKey(static_cast<int>(n % KEYS)), new IntValue(n / d), context);
+    }
+
+    void reduce(const IntermediateVec* pairs, void* context) const override {
+        auto* key = static_cast<IntKey*>(pairs->front().first);
+        long sum = 0;
+        for (const auto& [pairKey, pairValue] : *pairs) {
+            sum += static_cast<IntValue*>(pairValue)->value;
+            if (pairKey != key) {
+                delete pairKey;
+            }
+            delete pairValue;
+        }
+        if (throwing && lastIteration == THROWING_ITERATION) {
+            delete key;
+            throw std::runtime_error("throwing reduce");
+        }
+        emit3(key, new IntValue(sum), context);
+    }
+
+    void releaseIntermediate(K2* key, V2* value) const override {
+        delete key;
+        delete value;
+    }
+
+    bool converged(int, const OutputVec& output) const override {
+        for (const auto& [key, value] : output) {
+            if (static_cast<const IntValue*>(value)->value != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void feedback(OutputVec& output, InputVec& input) const override {
+        freeInput(input);
+        for (auto& [key, value] : output) {
+            delete static_cast<IntKey*>(key);
+            input.emplace_back(nullptr, static_cast<IntValue*>(value)); // The sum is the next input value
+        }
+    }
+
+private:
+    const long divisor = 2;
+    const bool throwing;
+    mutable int lastIteration = -1; // The iteration whose broadcast was taken last
+};
+
+/**
+ * Runs the iterations of a HalvingClient without the framework.
+ * @param input The values of the first iteration.
+ * @param iterations Set to the number of iterations until convergence.
+ * @return The output of the last iteration, by key.
+ */
+static std::map<int, long> expectedHalving(std::vector<long> input, int& iterations) {
+    iterations = 0;
+    while (true) {
+        ++iterations;
+        std::map<int, long> sums;
+        for (const long n : input) {
+            sums[static_cast<int>(n % KEYS)] += n / 2;
+        }
+        input.clear();
+        bool zero = true;
+        for (const auto& [key, sum] : sums) {
+            input.push_back(sum);
+            zero = zero && sum == 0;
+        }
+        if (zero) {
+            return sums;
+        }
+    }
+}
+
+/**
+ * Tests that an iterative job runs until its client converges, in every reduce mode.
+ */
+static bool testConvergence() {
+    const HalvingClient client;
+    std::vector<long> values;
+    for (int i = 0; i < INPUT_SIZE; ++i) {
+        values.push_back(i * i);
+    }
+    int expectedIterations;
+    const std::map<int, long> expected = expectedHalving(values, expectedIterations);
+    for (const bool streaming : {false, true}) {
+        JobConfig config;
+        config.multiThreadLevel = THREADS;
+        config.streamingReduce = streaming;
+        InputVec input;
+        for (const long value : values) {
+            input.emplace_back(nullptr, new IntValue(value));
+        }
+        OutputVec output;
+        const int iterations = runIterativeJob(client, input, output, config, MAX_ITERATIONS);
+        std::map<int, long> actual;
+        for (const auto& [key, value] : output) {
+            actual[static_cast<const IntKey*>(key)->value] = static_cast<const IntValue*>(value)->value;
+        }
+        freeOutput(output);
+        freeInput(input);
+        CHECK(iterations == expectedIterations);
+        CHECK(actual == expected);
+        CHECK(liveObjects.load() == 0);
+    }
+    return true;
+}
+
+/**
+ * Tests an iterative job stopped by its maximal number of iterations, and one whose iteration fails.
+ */
+static bool testStops() {
+    JobConfig config;
+    config.multiThreadLevel = THREADS;
+    const HalvingClient client;
+    InputVec input = makeInput(INPUT_SIZE);
+    OutputVec output;
+    CHECK(runIterativeJob(client, input, output, config, 1) == 1);
+    CHECK(output.size() == KEYS);
+    freeOutput(output);
+    freeInput(input);
+
+    const HalvingClient failing(true);
+    input = makeInput(INPUT_SIZE);
+    CHECK(runIterativeJob(failing, input, output, config, MAX_ITERATIONS) == ITERATIVE_JOB_FAILED);
+    freeOutput(output); // The partial output of the failed iteration
+    freeInput(input);
+    CHECK(liveObjects.load() == 0);
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"convergence", testConvergence},
+        {"stops", testStops},
+    });
+}
@@ -0,0 +1,173 @@
+/**
+ * Tests of the errors of jobs whose client throws: the error must be reported with its stage and
+ * task, and every intermediate pair that was not reduced must be released.
+ */
+#include <string>
+#include "TestUtil.h"
+
+#define SHUFFLE_RUNS 20 // Runs of a job failing in the shuffle, since the failure races with the other workers
+#define THROWING_MAP_INPUT 42 // The input value whose map throws
+
+/**
+ * Runs a failing job, and checks its error and that all its pairs were released.
+ * @param client The client of the job.
+ * @param config The configuration of the job.
+ * @param message The message of the exception the client throws.
+ * @param stage The stage the error should be reported in, or UNDEFINED_STAGE if it may be any.
+ * @return true if the job failed as expected, false otherwise.
+ */
+static bool checkFailingJob(const SumClient& client, const JobConfig& config, const char* message,
+                            const stage_t stage) {
+    InputVec input = makeInput(INPUT_SIZE);
+    OutputVec output;
+    JobHandle job = startMapReduceJob(client, input, output, config);
+    waitForJob(job);
+    JobError error;
+    const bool failed = getJobError(job, &error);
+    closeJobHandle(job);
+    freeOutput(output); // Whatever was emitted before the error
+    freeInput(input);
+    CHECK(failed);
+    CHECK(stage == UNDEFINED_STAGE || error.stage == stage);
+    try {
+        std::rethrow_exception(error.exception);
+    } catch (const std::runtime_error& e) {
+        CHECK(std::string(e.what()) == message);
+    }
+    CHECK(liveObjects.load() == 0);
+    return true;
+}
+
+/**
+ * Tests jobs whose key comparisons throw, in every reduce mode.
+ */
+static bool testThrowingCompare() {
+    const SumClient client(POISON_KEY);
+    for (const bool deterministic : {false, true}) {
+        for (const bool streaming : {false, true}) {
+            JobConfig config;
+            config.multiThreadLevel = THREADS;
+            config.deterministic = deterministic;
+            config.streamingReduce = streaming;
+            CHECK(checkFailingJob(client, config, "poisoned comparison", UNDEFINED_STAGE));
+        }
+    }
+    return true;
+}
+
+/**
+ * Tests jobs whose shuffle throws after the workers passed the barrier of the map phase, so the
+ * other workers must not leave the job while thread 0 is still shuffling.
+ */
+static bool testThrowingShuffle() {
+    const SumClient client(SHUFFLE_POISON_KEY);
+    for (const int threads : {2, 16}) {
+        for (const bool deterministic : {false, true}) {
+            JobConfig config;
+            config.multiThreadLevel = threads;
+            config.deterministic = deterministic;
+            for (int run = 0; run < SHUFFLE_RUNS; ++run) {
+                CHECK(checkFailingJob(client, config, "poisoned comparison", SHUFFLE_STAGE));
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Tests jobs whose reduce throws, in every reduce mode.
+ */
+static bool testThrowingReduce() {
+    const SumClient client(0, true);
+    for (const bool deterministic : {false, true}) {
+        for (const bool streaming : {false, true}) {
+            JobConfig config;
+            config.multiThreadLevel = THREADS;
+            config.deterministic = deterministic;
+            config.streamingReduce = streaming;
+            CHECK(checkFailingJob(client, config, "throwing reduce", REDUCE_STAGE));
+        }
+    }
+    return true;
+}
+
+/**
+ * A client which emits the pairs of SumClient, but whose map of THROWING_MAP_INPUT throws.
+ */
+class ThrowingMapClient final : public MapReduceClient {
+public:
+    void map(const K1* key, const V1* value, void* context) const override {
+        sum.map(key, value, context);
+        if (static_cast<const IntValue*>(value)->value == THROWING_MAP_INPUT) {
+            throw std::runtime_error("throwing map");
+        }
+    }
+
+    void reduce(const IntermediateVec* pairs, void* context) const override {
+        sum.reduce(pairs, context);
+    }
+
+    void releaseIntermediate(K2* key, V2* value) const override {
+        sum.releaseIntermediate(key, value);
+    }
+
+private:
+    const SumClient sum;
+};
+
+/**
+ * Tests a job whose map throws: the error must name the input pair, waitForJobOrThrow must
+ * rethrow it, and the pairs the failed call emitted must be released with all the others.
+ */
+static bool testThrowingMap() {
+    const ThrowingMapClient client;
+    JobConfig config;
+    config.multiThreadLevel = THREADS;
+    InputVec input = makeInput(INPUT_SIZE);
+    OutputVec output;
+    JobHandle job = startMapReduceJob(client, input, output, config);
+    bool rethrown = false;
+    try {
+        waitForJobOrThrow(job);
+    } catch (const std::runtime_error& e) {
+        rethrown = std::string(e.what()) == "throwing map";
+    }
+    JobError error;
+    const bool failed = getJobError(job, &error);
+    closeJobHandle(job);
+    freeOutput(output);
+    freeInput(input);
+    CHECK(rethrown);
+    CHECK(failed && error.stage == MAP_STAGE && error.taskIndex == THROWING_MAP_INPUT);
+    CHECK(liveObjects.load() == 0);
+    return true;
+}
+
+/**
+ * Tests that a job which did not fail reports no error, and that waitForJobOrThrow returns.
+ */
+static bool testNoError() {
+    const SumClient client;
+    JobConfig config;
+    config.multiThreadLevel = THREADS;
+    InputVec input = makeInput(INPUT_SIZE);
+    OutputVec output;
+    JobHandle job = startMapReduceJob(client, input, output, config);
+    waitForJobOrThrow(job);
+    JobError error;
+    CHECK(!getJobError(job, &error));
+    closeJobHandle(job);
+    freeInput(input);
+    CHECK(checkSums(output, INPUT_SIZE));
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"throwing map", testThrowingMap},
+        {"throwing compare", testThrowingCompare},
+        {"throwing shuffle", testThrowingShuffle},
+        {"throwing reduce", testThrowingReduce},
+        {"no error", testNoError},
+    });
+}
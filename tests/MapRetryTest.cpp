@@ -0,0 +1,137 @@
+/**
+ * Tests of the staged map emits, which let the framework retry a throwing map call, or skip its
+ * input pair, without keeping any of the pairs the call emitted.
+ */
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "TestUtil.h"
+
+#define MAP_RETRIES 2 // Retries of a throwing map call
+
+static const std::vector<size_t> flakyInputs = {3, 11, 150}; // The input values whose map calls throw
+
+/**
+ * A client which emits the pairs of SumClient, but whose map calls of flakyInputs throw after
+ * emitting them, on a given number of attempts.
+ */
+class FlakyClient final : public MapReduceClient {
+public:
+    /**
+     * @param failures The number of attempts of every flaky input pair that throw.
+     */
+    explicit FlakyClient(const int failures) : failures(failures), attempts(INPUT_SIZE) {}
+
+    void map(const K1* key, const V1* value, void* context) const override {
+        const auto n = static_cast<size_t>(static_cast<const IntValue*>(value)->value);
+        sum.map(key, value, context);
+        const bool flaky = std::find(flakyInputs.begin(), flakyInputs.end(), n) != flakyInputs.end();
+        if (flaky && attempts[n]++ < failures) {
+            throw std::runtime_error("flaky map");
+        }
+    }
+
+    void reduce(const IntermediateVec* pairs, void* context) const override {
+        sum.reduce(pairs, context);
+    }
+
+    void releaseIntermediate(K2* key, V2* value) const override {
+        sum.releaseIntermediate(key, value);
+    }
+
+private:
+    const SumClient sum;
+    const int failures;
+    mutable std::vector<std::atomic<int>> attempts; // The map calls of every input value so far
+};
+
+/**
+ * Checks the output of a FlakyClient job whose flaky input pairs were skipped, and frees it.
+ * @param output The output pairs.
+ * @return true if every key has the sum of the other input pairs, false otherwise.
+ */
+static bool checkSkippedSums(OutputVec& output) {
+    std::map<int, long> expected;
+    for (size_t n = 0; n < INPUT_SIZE; ++n) {
+        if (std::find(flakyInputs.begin(), flakyInputs.end(), n) != flakyInputs.end()) {
+            continue;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            expected[static_cast<int>(i % KEYS)] += i;
+        }
+    }
+    std::map<int, long> actual;
+    for (const auto& [key, value] : output) {
+        actual[static_cast<const IntKey*>(key)->value] += static_cast<const IntValue*>(value)->value;
+    }
+    freeOutput(output);
+    return actual == expected;
+}
+
+/**
+ * Tests jobs whose flaky map calls succeed when retried, in every reduce mode: none of the pairs
+ * the throwing attempts emitted may be kept.
+ */
+static bool testRetries() {
+    for (const bool streaming : {false, true}) {
+        const FlakyClient client(MAP_RETRIES);
+        JobConfig config;
+        config.multiThreadLevel = THREADS;
+        config.streamingReduce = streaming;
+        config.catchMapExceptions = true;
+        config.mapRetries = MAP_RETRIES;
+        InputVec input = makeInput(INPUT_SIZE);
+        OutputVec output;
+        JobHandle job = startMapReduceJob(client, input, output, config);
+        waitForJob(job);
+        JobStats stats;
+        getJobStats(job, &stats);
+        JobError error;
+        const bool failed = getJobError(job, &error);
+        closeJobHandle(job);
+        freeInput(input);
+        CHECK(!failed);
+        CHECK(stats.retriedMapCalls == flakyInputs.size() * MAP_RETRIES);
+        CHECK(stats.failedMapInputs == 0);
+        CHECK(checkSums(output, INPUT_SIZE));
+        CHECK(liveObjects.load() == 0);
+    }
+    return true;
+}
+
+/**
+ * Tests a job whose flaky map calls throw on every attempt: their input pairs must be recorded as
+ * failed, and the job must go on without their output.
+ */
+static bool testFailedInputs() {
+    const FlakyClient client(MAP_RETRIES + 1);
+    JobConfig config;
+    config.multiThreadLevel = THREADS;
+    config.catchMapExceptions = true;
+    config.mapRetries = MAP_RETRIES;
+    InputVec input = makeInput(INPUT_SIZE);
+    OutputVec output;
+    JobHandle job = startMapReduceJob(client, input, output, config);
+    waitForJob(job);
+    JobStats stats;
+    getJobStats(job, &stats);
+    std::vector<size_t> failedInputs;
+    getFailedMapInputs(job, failedInputs);
+    JobError error;
+    const bool failed = getJobError(job, &error);
+    closeJobHandle(job);
+    freeInput(input);
+    CHECK(!failed);
+    CHECK(failedInputs == flakyInputs);
+    CHECK(stats.failedMapInputs == failedInputs.size());
+    CHECK(checkSkippedSums(output));
+    CHECK(liveObjects.load() == 0);
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"retries", testRetries},
+        {"failed inputs", testFailedInputs},
+    });
+}
@@ -0,0 +1,105 @@
+/**
+ * Tests of the memory budgets: the budget itself, and jobs that fit in it or run out of it.
+ */
+#include <chrono>
+#include <thread>
+#include "TestUtil.h"
+#include "../include/MemoryBudget.h"
+
+#define SMALL_BUDGET_BYTES (256 * 1024) // Far less than the intermediate pairs of a job need
+#define LARGE_BUDGET_BYTES (1 << 30) // Far more than the intermediate pairs of a job need
+#define LONG_WAIT_MS 10000 // A wait for room that a test would notice
+
+/**
+ * Tests the charges and releases of a budget, and a charge that waits for another thread to
+ * release room.
+ */
+static bool testBudget() {
+    MemoryBudget budget(100);
+    CHECK(budget.tryCharge(60, std::chrono::milliseconds(0)));
+    CHECK(!budget.tryCharge(60, std::chrono::milliseconds(0)));
+    CHECK(budget.used() == 60);
+    budget.charge(60); // Charged even though it exceeds the limit
+    CHECK(budget.used() == 120 && budget.highWater() == 120);
+    budget.release(120);
+    CHECK(budget.used() == 0 && budget.highWater() == 120);
+
+    budget.charge(100);
+    std::thread releaser([&budget] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        budget.release(50);
+    });
+    const bool charged = budget.tryCharge(50, std::chrono::milliseconds(LONG_WAIT_MS));
+    releaser.join();
+    CHECK(charged);
+    CHECK(budget.used() == 100);
+    return true;
+}
+
+/**
+ * Tests jobs that run out of a budget of their own: they must fail without waiting for room
+ * (only the job itself could make it), produce no output, and release all their pairs.
+ */
+static bool testExceededBudget() {
+    const SumClient client;
+    for (const bool streaming : {false, true}) {
+        JobConfig config;
+        config.multiThreadLevel = THREADS;
+        config.streamingReduce = streaming;
+        config.memoryBudgetBytes = SMALL_BUDGET_BYTES;
+        config.memoryWaitMs = LONG_WAIT_MS;
+        InputVec input = makeInput(INPUT_SIZE);
+        OutputVec output;
+        const auto start = std::chrono::steady_clock::now();
+        JobHandle job = startMapReduceJob(client, input, output, config);
+        waitForJob(job);
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        JobStats stats;
+        getJobStats(job, &stats);
+        closeJobHandle(job);
+        freeInput(input);
+        CHECK(stats.memoryBudgetExceeded);
+        CHECK(elapsed < std::chrono::milliseconds(LONG_WAIT_MS / 2));
+        CHECK(output.empty());
+        CHECK(liveObjects.load() == 0);
+    }
+    return true;
+}
+
+/**
+ * Tests jobs that fit in a budget shared with other jobs: their output must be complete, and the
+ * budget must be back to empty once they are closed.
+ */
+static bool testSharedBudget() {
+    const SumClient client;
+    MemoryBudget budget(LARGE_BUDGET_BYTES);
+    for (const bool streaming : {false, true}) {
+        JobConfig config;
+        config.multiThreadLevel = THREADS;
+        config.streamingReduce = streaming;
+        config.memoryBudget = &budget;
+        InputVec input = makeInput(INPUT_SIZE);
+        OutputVec output;
+        JobHandle job = startMapReduceJob(client, input, output, config);
+        waitForJob(job);
+        JobStats stats;
+        getJobStats(job, &stats);
+        closeJobHandle(job);
+        freeInput(input);
+        CHECK(!stats.memoryBudgetExceeded);
+        CHECK(stats.memoryHighWaterBytes >= static_cast<size_t>(INPUT_SIZE) * (INPUT_SIZE - 1) / 2 *
+                                            sizeof(IntermediatePair));
+        CHECK(budget.used() == 0);
+        CHECK(checkSums(output, INPUT_SIZE));
+        CHECK(liveObjects.load() == 0);
+    }
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"budget", testBudget},
+        {"exceeded budget", testExceededBudget},
+        {"shared budget", testSharedBudget},
+    });
+}
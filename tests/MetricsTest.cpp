@@ -0,0 +1,137 @@
+/**
+ * Tests of the metrics registry, which exposes the metrics of its jobs to Prometheus, and of the
+ * live metrics of a job.
+ */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+#include "TestUtil.h"
+#include "../include/MetricsRegistry.h"
+
+#define JOB_NAME "sums" // The "job" label of the named test job
+
+/**
+ * Runs a job registered with a registry to completion, leaving its handle open.
+ * @param client The job's client.
+ * @param registry The registry.
+ * @param name The job's label, or nullptr.
+ * @param input The input pairs.
+ * @param output The output pairs.
+ * @return The job's handle.
+ */
+static JobHandle runRegisteredJob(const SumClient& client, MetricsRegistry& registry, const char* name,
+                                  InputVec& input, OutputVec& output) {
+    JobConfig config;
+    config.multiThreadLevel = THREADS;
+    config.metrics = &registry;
+    config.metricsName = name;
+    JobHandle job = startMapReduceJob(client, input, output, config);
+    waitForJob(job);
+    return job;
+}
+
+/**
+ * Tests the scrape of a registry: it must hold the metrics of every registered job under its
+ * label, and drop a job once its handle is closed.
+ */
+static bool testScrape() {
+    const SumClient client;
+    MetricsRegistry registry;
+    InputVec input = makeInput(INPUT_SIZE);
+    OutputVec namedOutput;
+    OutputVec unnamedOutput;
+    JobHandle named = runRegisteredJob(client, registry, JOB_NAME, input, namedOutput);
+    JobHandle unnamed = runRegisteredJob(client, registry, nullptr, input, unnamedOutput);
+    std::string text = registry.scrape();
+    CHECK(text.find("mapreduce_jobs_started_total 2\n") != std::string::npos);
+    CHECK(text.find("mapreduce_jobs_running 0\n") != std::string::npos);
+    CHECK(text.find("mapreduce_job_processed{job=\"" JOB_NAME "\",stage=\"map\"} "
+                    + std::to_string(INPUT_SIZE) + "\n") != std::string::npos);
+    CHECK(text.find("mapreduce_job_processed{job=\"" JOB_NAME "\",stage=\"reduce\"} "
+                    + std::to_string(KEYS) + "\n") != std::string::npos);
+    CHECK(text.find("mapreduce_job_failed{job=\"job-2\"} 0\n") != std::string::npos);
+
+    closeJobHandle(named);
+    text = registry.scrape();
+    CHECK(text.find("job=\"" JOB_NAME "\"") == std::string::npos);
+    CHECK(text.find("job=\"job-2\"") != std::string::npos);
+    closeJobHandle(unnamed);
+    freeInput(input);
+    CHECK(checkSums(namedOutput, INPUT_SIZE));
+    CHECK(checkSums(unnamedOutput, INPUT_SIZE));
+    return true;
+}
+
+/**
+ * Tests that the metrics of a reusable job describe its current run only.
+ */
+static bool testRunMetrics() {
+    const SumClient client;
+    JobConfig config;
+    config.multiThreadLevel = THREADS;
+    JobHandle job = createReusableJob(config);
+    for (int run = 1; run <= 3; ++run) {
+        InputVec input = makeInput(INPUT_SIZE * run);
+        OutputVec output;
+        restartMapReduceJob(job, client, input, output);
+        waitForJob(job);
+        JobMetrics metrics;
+        getJobMetrics(job, &metrics);
+        freeInput(input);
+        CHECK(metrics.processed[MAP_STAGE] == static_cast<uint64_t>(INPUT_SIZE * run));
+        CHECK(metrics.processed[REDUCE_STAGE] == KEYS);
+        CHECK(metrics.pendingMapTasks == 0 && metrics.pendingOutputPairs == 0);
+        CHECK(checkSums(output, INPUT_SIZE * run));
+    }
+    closeJobHandle(job);
+    return true;
+}
+
+/**
+ * Tests serving the metrics over HTTP: a GET request must be answered with the scrape.
+ */
+static bool testServe() {
+    const SumClient client;
+    MetricsRegistry registry;
+    CHECK(registry.serve(0));
+    CHECK(registry.port() > 0);
+    CHECK(!registry.serve(0));
+    InputVec input = makeInput(INPUT_SIZE);
+    OutputVec output;
+    JobHandle job = runRegisteredJob(client, registry, JOB_NAME, input, output);
+
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(registry.port()));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CHECK(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+    const std::string request = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    CHECK(write(fd, request.data(), request.size()) == static_cast<ssize_t>(request.size()));
+    std::string response;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+        response.append(buffer, static_cast<size_t>(n));
+    }
+    close(fd);
+
+    closeJobHandle(job);
+    freeInput(input);
+    registry.stopServing();
+    CHECK(registry.port() == 0);
+    CHECK(response.rfind("HTTP/1.1 200 OK\r\n", 0) == 0);
+    CHECK(response.find("mapreduce_job_processed{job=\"" JOB_NAME "\"") != std::string::npos);
+    CHECK(checkSums(output, INPUT_SIZE));
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"scrape", testScrape},
+        {"run metrics", testRunMetrics},
+        {"serve", testServe},
+    });
+}
@@ -0,0 +1,123 @@
+/**
+ * Tests of the lock-free output queue, on its own and as the output of a job.
+ */
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "TestUtil.h"
+#include "../include/OutputQueue.h"
+
+#define PRODUCERS 8 // Threads emitting into the output queue at once
+#define PAIRS_PER_PRODUCER 10000 // Not a multiple of OUTPUT_CHUNK_CAPACITY, so the last chunk is flushed
+
+/**
+ * A key which tells the producer that emitted it and its index among the producer's pairs.
+ */
+class TagKey final : public K3 {
+public:
+    TagKey(const int producer, const int index) : producer(producer), index(index) {}
+
+    bool operator<(const K3& other) const override {
+        return index < static_cast<const TagKey&>(other).index;
+    }
+
+    int producer;
+    int index;
+};
+
+/**
+ * Tests the output queue while many producers emit and a consumer drains at once: every pair
+ * must be drained exactly once, and the pairs of every producer in their emitting order.
+ */
+static bool testOutputQueueContention() {
+    std::vector<std::vector<TagKey>> keys(PRODUCERS);
+    for (int producer = 0; producer < PRODUCERS; ++producer) {
+        for (int i = 0; i < PAIRS_PER_PRODUCER; ++i) {
+            keys[producer].emplace_back(producer, i);
+        }
+    }
+
+    OutputQueue queue;
+    std::atomic<bool> start{false};
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < PRODUCERS; ++producer) {
+        producers.emplace_back([&, producer] {
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            OutputChunk* chunk = nullptr;
+            for (TagKey& key : keys[producer]) {
+                queue.emit(chunk, &key, nullptr);
+            }
+            queue.flush(chunk);
+        });
+    }
+
+    start.store(true, std::memory_order_release);
+    std::vector<int> nextIndex(PRODUCERS, 0);
+    size_t drained = 0;
+    bool ordered = true;
+    OutputVec out;
+    while (drained < static_cast<size_t>(PRODUCERS) * PAIRS_PER_PRODUCER) {
+        out.clear();
+        drained += queue.drain(out);
+        for (const auto& [key, value] : out) {
+            const auto* tag = static_cast<const TagKey*>(key);
+            ordered = ordered && tag->index == nextIndex[tag->producer];
+            ++nextIndex[tag->producer];
+        }
+    }
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+
+    CHECK(ordered);
+    CHECK(queue.pending() == 0);
+    out.clear();
+    CHECK(queue.drain(out) == 0);
+    for (const int index : nextIndex) {
+        CHECK(index == PAIRS_PER_PRODUCER);
+    }
+    return true;
+}
+
+/**
+ * Tests a job whose output is polled while it runs: the polled pairs and the pairs left in the
+ * output vector must together be the whole output.
+ */
+static bool testPolledJob() {
+    const SumClient client;
+    for (const bool streaming : {false, true}) {
+        JobConfig config;
+        config.multiThreadLevel = THREADS;
+        config.streamingReduce = streaming;
+        config.outputQueue = true;
+        InputVec input = makeInput(INPUT_SIZE);
+        OutputVec output;
+        OutputVec polled;
+        JobHandle job = startMapReduceJob(client, input, output, config);
+        JobState state;
+        do {
+            getJobState(job, &state);
+            pollJobOutput(job, polled);
+        } while (state.stage != REDUCE_STAGE || state.percentage < MAX_PERCENTAGE);
+        waitForJob(job);
+        JobMetrics metrics;
+        getJobMetrics(job, &metrics);
+        closeJobHandle(job);
+        freeInput(input);
+        CHECK(metrics.pendingOutputPairs == 0);
+        CHECK(output.size() + polled.size() == KEYS);
+        output.insert(output.end(), polled.begin(), polled.end());
+        CHECK(checkSums(output, INPUT_SIZE));
+        CHECK(liveObjects.load() == 0);
+    }
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"output queue contention", testOutputQueueContention},
+        {"polled job", testPolledJob},
+    });
+}
@@ -0,0 +1,88 @@
+/**
+ * Tests of the performance counters, which measure every phase of the workers of a job. The
+ * hardware events may not be countable here (e.g. in a virtual machine), so they are only checked
+ * when JobStats::perfEvents says they are counted.
+ */
+#include "TestUtil.h"
+
+/**
+ * Tests the counters of jobs in every reduce mode: every worker must have measured its map and
+ * reduce phases, and the counts of the job must be the sums of those of its workers.
+ */
+static bool testPhaseCounters() {
+    const SumClient client;
+    for (const bool streaming : {false, true}) {
+        JobConfig config;
+        config.multiThreadLevel = THREADS;
+        config.streamingReduce = streaming;
+        config.perfCounters = true;
+        InputVec input = makeInput(INPUT_SIZE);
+        OutputVec output;
+        JobHandle job = startMapReduceJob(client, input, output, config);
+        waitForJob(job);
+        JobStats stats;
+        getJobStats(job, &stats);
+        PhaseCounters sums[PERF_PHASES] = {};
+        for (int worker = 0; worker < THREADS; ++worker) {
+            PhaseCounters counters[PERF_PHASES];
+            getWorkerPerfCounters(job, worker, counters);
+            CHECK(counters[PERF_MAP].nanos > 0 && counters[PERF_REDUCE].nanos > 0);
+            for (int phase = 0; phase < PERF_PHASES; ++phase) {
+                sums[phase].nanos += counters[phase].nanos;
+                sums[phase].instructions += counters[phase].instructions;
+            }
+        }
+        closeJobHandle(job);
+        freeInput(input);
+        CHECK((stats.perfEvents & ~PERF_ALL_EVENTS) == 0);
+        for (int phase = 0; phase < PERF_PHASES; ++phase) {
+            CHECK(stats.perfCounters[phase].nanos == sums[phase].nanos);
+            CHECK(stats.perfCounters[phase].instructions == sums[phase].instructions);
+        }
+        if (stats.perfEvents & PERF_EVENT_INSTRUCTIONS) {
+            CHECK(stats.perfCounters[PERF_MAP].instructions > 0);
+        } else {
+            CHECK(stats.perfCounters[PERF_MAP].instructions == 0);
+        }
+        CHECK(checkSums(output, INPUT_SIZE));
+    }
+    return true;
+}
+
+/**
+ * Tests that a worker out of range gets zero counts, and that a job without counters measures
+ * nothing.
+ */
+static bool testNoCounters() {
+    const SumClient client;
+    for (const bool enabled : {false, true}) {
+        JobConfig config;
+        config.multiThreadLevel = THREADS;
+        config.perfCounters = enabled;
+        InputVec input = makeInput(INPUT_SIZE);
+        OutputVec output;
+        JobHandle job = startMapReduceJob(client, input, output, config);
+        waitForJob(job);
+        JobStats stats;
+        getJobStats(job, &stats);
+        PhaseCounters counters[PERF_PHASES];
+        getWorkerPerfCounters(job, enabled ? THREADS : 0, counters);
+        closeJobHandle(job);
+        freeInput(input);
+        for (int phase = 0; phase < PERF_PHASES; ++phase) {
+            CHECK(counters[phase].nanos == 0 && counters[phase].cycles == 0);
+        }
+        if (!enabled) {
+            CHECK(stats.perfEvents == 0 && stats.perfCounters[PERF_MAP].nanos == 0);
+        }
+        CHECK(checkSums(output, INPUT_SIZE));
+    }
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"phase counters", testPhaseCounters},
+        {"no counters", testNoCounters},
+    });
+}
@@ -0,0 +1,134 @@
+/**
+ * Tests of the thread levels of the phases, which let fewer workers than the job has run its map
+ * or reduce phase.
+ */
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include "TestUtil.h"
+#include "../include/FairScheduler.h"
+
+#define MAP_LEVEL 1 // The workers that run the map phase of the tested jobs
+#define REDUCE_LEVEL 2 // The workers that run the reduce phase of the tested jobs
+#define CALL_US 100 // The duration of every map and reduce call of ThreadsClient
+
+/**
+ * A client which emits the pairs of SumClient, and records the threads its map and reduce calls
+ * ran on. Every call takes CALL_US, so all the workers of a phase get to run some of them.
+ */
+class ThreadsClient final : public MapReduceClient {
+public:
+    void map(const K1* key, const V1* value, void* context) const override {
+        record(mapThreads);
+        sum.map(key, value, context);
+    }
+
+    void reduce(const IntermediateVec* pairs, void* context) const override {
+        record(reduceThreads);
+        sum.reduce(pairs, context);
+    }
+
+    void releaseIntermediate(K2* key, V2* value) const override {
+        sum.releaseIntermediate(key, value);
+    }
+
+    mutable std::set<std::thread::id> mapThreads; // The threads the map calls ran on
+    mutable std::set<std::thread::id> reduceThreads; // The threads the reduce calls ran on
+
+private:
+    /**
+     * Records the calling thread, and takes CALL_US.
+     * @param threads The threads of the phase.
+     */
+    void record(std::set<std::thread::id>& threads) const {
+        {
+            std::lock_guard<std::mutex> lock(threadsMutex);
+            threads.insert(std::this_thread::get_id());
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(CALL_US));
+    }
+
+    const SumClient sum;
+    mutable std::mutex threadsMutex; // Mutex for the recorded threads
+};
+
+/**
+ * Runs a job to completion, and checks its phases ran on the given number of workers at most.
+ * @param config The job's configuration.
+ * @param mapThreads The most workers of the map phase.
+ * @param reduceThreads The most workers of the reduce phase.
+ * @return true if the phases ran on at most that many workers, and the output is complete.
+ */
+static bool runLevelsJob(const JobConfig& config, const int mapThreads, const int reduceThreads) {
+    const ThreadsClient client;
+    InputVec input = makeInput(INPUT_SIZE);
+    OutputVec output;
+    JobHandle job = startMapReduceJob(client, input, output, config);
+    waitForJob(job);
+    JobStats stats;
+    getJobStats(job, &stats);
+    closeJobHandle(job);
+    freeInput(input);
+    CHECK(stats.mapThreads == mapThreads && stats.reduceThreads == reduceThreads);
+    CHECK(static_cast<int>(client.mapThreads.size()) <= mapThreads);
+    CHECK(static_cast<int>(client.reduceThreads.size()) <= reduceThreads);
+    CHECK(checkSums(output, INPUT_SIZE));
+    return true;
+}
+
+/**
+ * Tests jobs whose phases run on fewer workers, in every reduce mode.
+ */
+static bool testPhaseLevels() {
+    for (const bool streaming : {false, true}) {
+        JobConfig config;
+        config.multiThreadLevel = THREADS;
+        config.streamingReduce = streaming;
+        config.mapThreadLevel = MAP_LEVEL;
+        config.reduceThreadLevel = REDUCE_LEVEL;
+        CHECK(runLevelsJob(config, MAP_LEVEL, REDUCE_LEVEL));
+        CHECK(liveObjects.load() == 0);
+    }
+    return true;
+}
+
+/**
+ * Tests that a level of 0 or above multiThreadLevel runs the phase on all the workers.
+ */
+static bool testDefaultLevels() {
+    JobConfig config;
+    config.multiThreadLevel = THREADS;
+    config.mapThreadLevel = 0;
+    config.reduceThreadLevel = THREADS * 2;
+    CHECK(runLevelsJob(config, THREADS, THREADS));
+    CHECK(liveObjects.load() == 0);
+    return true;
+}
+
+/**
+ * Tests jobs whose phases run on fewer workers, sharing a scheduler with a single slot.
+ */
+static bool testScheduledLevels() {
+    FairScheduler scheduler(1);
+    JobConfig config;
+    config.multiThreadLevel = THREADS;
+    config.scheduler = &scheduler;
+    config.mapThreadLevel = MAP_LEVEL;
+    config.reduceThreadLevel = REDUCE_LEVEL;
+    bool otherPassed = false;
+    std::thread other([&] { otherPassed = runLevelsJob(config, MAP_LEVEL, REDUCE_LEVEL); });
+    const bool passed = runLevelsJob(config, MAP_LEVEL, REDUCE_LEVEL);
+    other.join();
+    CHECK(passed && otherPassed);
+    CHECK(liveObjects.load() == 0);
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"phase levels", testPhaseLevels},
+        {"default levels", testDefaultLevels},
+        {"scheduled levels", testScheduledLevels},
+    });
+}
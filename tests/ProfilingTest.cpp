@@ -0,0 +1,122 @@
+/**
+ * Tests of the task profiles: the latency histograms, the slowest calls, and the profile of a job.
+ */
+#include <chrono>
+#include <thread>
+#include "TestUtil.h"
+#include "../include/LatencyProfile.h"
+
+#define SLOW_INPUT 9 // The input value whose map call is slow
+#define SLOW_CALL_MS 20 // The duration of the slow map call
+#define SLOWEST_TASKS 3 // The slowest calls kept by the tested profiles
+
+/**
+ * A client which emits the pairs of SumClient, but whose map call of SLOW_INPUT sleeps first.
+ */
+class SlowInputClient final : public MapReduceClient {
+public:
+    void map(const K1* key, const V1* value, void* context) const override {
+        if (static_cast<const IntValue*>(value)->value == SLOW_INPUT) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(SLOW_CALL_MS));
+        }
+        sum.map(key, value, context);
+    }
+
+    void reduce(const IntermediateVec* pairs, void* context) const override {
+        sum.reduce(pairs, context);
+    }
+
+    void releaseIntermediate(K2* key, V2* value) const override {
+        sum.releaseIntermediate(key, value);
+    }
+
+private:
+    const SumClient sum;
+};
+
+/**
+ * Tests the statistics of a histogram, which must be within its relative error, and its merge.
+ */
+static bool testHistogram() {
+    LatencyHistogram histogram;
+    CHECK(histogram.count() == 0 && histogram.min() == 0 && histogram.percentile(50) == 0);
+    for (uint64_t nanos = 1; nanos <= 1000; ++nanos) {
+        histogram.record(nanos);
+    }
+    CHECK(histogram.count() == 1000);
+    CHECK(histogram.min() == 1 && histogram.max() == 1000);
+    CHECK(histogram.mean() == 500.5);
+    const uint64_t median = histogram.percentile(50);
+    CHECK(median >= 500 && median <= 500 + 500 / HISTOGRAM_SUB_BUCKETS);
+    CHECK(histogram.percentile(100) == 1000);
+
+    LatencyHistogram other;
+    other.record(1000000);
+    histogram.merge(other);
+    CHECK(histogram.count() == 1001 && histogram.max() == 1000000);
+    histogram.clear();
+    CHECK(histogram.count() == 0 && histogram.max() == 0);
+    return true;
+}
+
+/**
+ * Tests that a profile keeps its slowest calls, slowest first, also when merged with another.
+ */
+static bool testSlowest() {
+    TaskProfile profile(SLOWEST_TASKS);
+    for (size_t i = 0; i < 10; ++i) {
+        profile.record(MAP_STAGE, i, i * 10);
+    }
+    TaskProfile other(SLOWEST_TASKS);
+    other.record(REDUCE_STAGE, 0, 85);
+    profile.merge(other);
+    const std::vector<SlowTask> slowest = profile.slowest();
+    CHECK(slowest.size() == SLOWEST_TASKS);
+    CHECK(slowest[0].stage == MAP_STAGE && slowest[0].index == 9 && slowest[0].nanos == 90);
+    CHECK(slowest[1].stage == REDUCE_STAGE && slowest[1].nanos == 85);
+    CHECK(slowest[2].index == 8);
+    CHECK(profile.mapLatency().count() == 10 && profile.reduceLatency().count() == 1);
+    return true;
+}
+
+/**
+ * Tests the profile of a job: every map and reduce call must be recorded, and its slow map call
+ * must be the slowest. A job that is not profiled records nothing.
+ */
+static bool testJobProfile() {
+    const SlowInputClient client;
+    for (const bool profiled : {false, true}) {
+        JobConfig config;
+        config.multiThreadLevel = THREADS;
+        config.profileTasks = profiled;
+        config.slowestTasks = SLOWEST_TASKS;
+        InputVec input = makeInput(INPUT_SIZE);
+        OutputVec output;
+        JobHandle job = startMapReduceJob(client, input, output, config);
+        waitForJob(job);
+        TaskProfile profile;
+        getTaskProfile(job, profile);
+        closeJobHandle(job);
+        freeInput(input);
+        CHECK(checkSums(output, INPUT_SIZE));
+        if (!profiled) {
+            CHECK(profile.mapLatency().count() == 0 && profile.slowest().empty());
+            continue;
+        }
+        CHECK(profile.mapLatency().count() == INPUT_SIZE);
+        CHECK(profile.reduceLatency().count() == KEYS);
+        const std::vector<SlowTask> slowest = profile.slowest();
+        CHECK(slowest.size() == SLOWEST_TASKS);
+        CHECK(slowest[0].stage == MAP_STAGE && slowest[0].index == SLOW_INPUT);
+        CHECK(slowest[0].nanos >= SLOW_CALL_MS * 1000000ull / 2); // The tick rate is only calibrated
+    }
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"histogram", testHistogram},
+        {"slowest", testSlowest},
+        {"job profile", testJobProfile},
+    });
+}
@@ -0,0 +1,107 @@
+/**
+ * Tests of the progress estimate of a whole run of a job.
+ */
+#include <chrono>
+#include <thread>
+#include "TestUtil.h"
+
+#define SLOW_MAP_US 200 // The duration of every map call of SlowClient
+#define POLL_MS 5 // The time between polls of a running job's progress
+
+/**
+ * A client which emits the pairs of SumClient, but whose map calls wait until it is opened, and
+ * take SLOW_MAP_US each from then on.
+ */
+class SlowClient final : public MapReduceClient {
+public:
+    void map(const K1* key, const V1* value, void* context) const override {
+        while (!open) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(SLOW_MAP_US));
+        sum.map(key, value, context);
+    }
+
+    void reduce(const IntermediateVec* pairs, void* context) const override {
+        sum.reduce(pairs, context);
+    }
+
+    void releaseIntermediate(K2* key, V2* value) const override {
+        sum.releaseIntermediate(key, value);
+    }
+
+    mutable std::atomic<bool> open{false}; // Whether the map calls may go on
+
+private:
+    const SumClient sum;
+};
+
+/**
+ * Tests the progress of a finished job, in every reduce mode.
+ */
+static bool testDone() {
+    const SumClient client;
+    for (const bool streaming : {false, true}) {
+        JobConfig config;
+        config.multiThreadLevel = THREADS;
+        config.streamingReduce = streaming;
+        InputVec input = makeInput(INPUT_SIZE);
+        OutputVec output;
+        JobHandle job = startMapReduceJob(client, input, output, config);
+        waitForJob(job);
+        JobProgress progress;
+        getJobProgress(job, &progress);
+        closeJobHandle(job);
+        freeInput(input);
+        CHECK(progress.stage == REDUCE_STAGE);
+        CHECK(progress.stagePercentage == 100 && progress.overallPercentage == 100);
+        CHECK(progress.etaSeconds == 0 && progress.elapsedSeconds > 0);
+        CHECK(checkSums(output, INPUT_SIZE));
+    }
+    return true;
+}
+
+/**
+ * Tests the progress of the runs of a reusable job while they run: there is no estimate until a
+ * pair is mapped, and from then on the estimates must be within bounds.
+ */
+static bool testRunning() {
+    JobConfig config;
+    config.multiThreadLevel = THREADS;
+    JobHandle job = createReusableJob(config);
+    for (int run = 1; run <= 2; ++run) {
+        const SlowClient client;
+        InputVec input = makeInput(INPUT_SIZE);
+        OutputVec output;
+        restartMapReduceJob(job, client, input, output);
+        std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS));
+        JobProgress progress;
+        getJobProgress(job, &progress);
+        CHECK(progress.etaSeconds == -1 && progress.overallPercentage < 100);
+
+        client.open = true;
+        JobState state;
+        do {
+            std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS));
+            getJobProgress(job, &progress);
+            getJobState(job, &state);
+            CHECK(progress.overallPercentage >= 0 && progress.overallPercentage <= 100);
+            CHECK(progress.stagePercentage >= 0 && progress.stagePercentage <= 100);
+            CHECK(progress.elapsedSeconds >= 0);
+        } while (state.stage != REDUCE_STAGE || state.percentage < 100);
+        waitForJob(job);
+        getJobProgress(job, &progress);
+        freeInput(input);
+        CHECK(progress.overallPercentage == 100 && progress.etaSeconds == 0);
+        CHECK(checkSums(output, INPUT_SIZE));
+    }
+    closeJobHandle(job);
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"done", testDone},
+        {"running", testRunning},
+    });
+}
@@ -0,0 +1,90 @@
+/**
+ * Tests of the reusable jobs, which keep their buffers between runs.
+ */
+#include "TestUtil.h"
+
+#define RUNS 5 // Runs of every reusable job
+
+/**
+ * Tests runs of a reusable job on different inputs, in every reduce mode: every run must produce
+ * its own complete output.
+ */
+static bool testRestarts() {
+    const SumClient client;
+    for (const bool streaming : {false, true}) {
+        JobConfig config;
+        config.multiThreadLevel = THREADS;
+        config.streamingReduce = streaming;
+        JobHandle job = createReusableJob(config);
+        for (int run = 0; run < RUNS; ++run) {
+            InputVec input = makeInput(INPUT_SIZE - run * 10, run);
+            OutputVec output;
+            restartMapReduceJob(job, client, input, output);
+            waitForJob(job);
+            freeInput(input);
+            CHECK(checkSums(output, INPUT_SIZE - run * 10, run));
+        }
+        closeJobHandle(job);
+        CHECK(liveObjects.load() == 0);
+    }
+    return true;
+}
+
+/**
+ * Tests a restart of a job whose previous run is still running, which must wait for it, and of
+ * a job started by startMapReduceJob.
+ */
+static bool testRestartRunningJob() {
+    const SumClient client;
+    JobConfig config;
+    config.multiThreadLevel = THREADS;
+    InputVec first = makeInput(INPUT_SIZE);
+    InputVec second = makeInput(INPUT_SIZE, 1);
+    OutputVec firstOutput;
+    OutputVec secondOutput;
+    JobHandle job = startMapReduceJob(client, first, firstOutput, config);
+    restartMapReduceJob(job, client, second, secondOutput);
+    CHECK(checkSums(firstOutput, INPUT_SIZE)); // The first run was done before the restart returned
+    waitForJob(job);
+    closeJobHandle(job);
+    freeInput(first);
+    freeInput(second);
+    CHECK(checkSums(secondOutput, INPUT_SIZE, 1));
+    CHECK(liveObjects.load() == 0);
+    return true;
+}
+
+/**
+ * Tests a run of a reusable job after a failed run: the error of the failed run must be cleared.
+ */
+static bool testRestartAfterError() {
+    const SumClient failing(0, true);
+    const SumClient client;
+    JobConfig config;
+    config.multiThreadLevel = THREADS;
+    JobHandle job = createReusableJob(config);
+    InputVec input = makeInput(INPUT_SIZE);
+    OutputVec output;
+    restartMapReduceJob(job, failing, input, output);
+    waitForJob(job);
+    JobError error;
+    CHECK(getJobError(job, &error));
+    freeOutput(output);
+
+    restartMapReduceJob(job, client, input, output);
+    waitForJob(job);
+    CHECK(!getJobError(job, &error));
+    closeJobHandle(job);
+    freeInput(input);
+    CHECK(checkSums(output, INPUT_SIZE));
+    CHECK(liveObjects.load() == 0);
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"restarts", testRestarts},
+        {"restart of a running job", testRestartRunningJob},
+        {"restart after an error", testRestartAfterError},
+    });
+}
@@ -0,0 +1,102 @@
+/**
+ * Tests of the jobs run to completion with the calling thread working as one of their workers.
+ */
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include "TestUtil.h"
+
+#define MAP_CALL_US 500 // The duration of every map call of ThreadsClient
+
+/**
+ * A client which emits the pairs of SumClient, and records the threads its map calls ran on.
+ * Every map call takes MAP_CALL_US, so all the workers get to map some of the pairs.
+ */
+class ThreadsClient final : public MapReduceClient {
+public:
+    void map(const K1* key, const V1* value, void* context) const override {
+        {
+            std::lock_guard<std::mutex> lock(threadsMutex);
+            mapThreads.insert(std::this_thread::get_id());
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(MAP_CALL_US));
+        sum.map(key, value, context);
+    }
+
+    void reduce(const IntermediateVec* pairs, void* context) const override {
+        sum.reduce(pairs, context);
+    }
+
+    void releaseIntermediate(K2* key, V2* value) const override {
+        sum.releaseIntermediate(key, value);
+    }
+
+    mutable std::mutex threadsMutex; // Mutex for mapThreads
+    mutable std::set<std::thread::id> mapThreads; // The threads the map calls ran on
+
+private:
+    const SumClient sum;
+};
+
+/**
+ * Tests runMapReduceJob, and runs of the same job again with rerunMapReduceJob.
+ */
+static bool testRunMapReduceJob() {
+    const SumClient client;
+    JobConfig config;
+    config.multiThreadLevel = THREADS;
+    InputVec empty;
+    OutputVec output;
+    CHECK(runMapReduceJob(client, empty, output, config) == nullptr);
+
+    InputVec input = makeInput(INPUT_SIZE);
+    JobHandle job = runMapReduceJob(client, input, output, config);
+    CHECK(job != nullptr);
+    JobError error;
+    CHECK(!getJobError(job, &error));
+    freeInput(input);
+    CHECK(checkSums(output, INPUT_SIZE));
+
+    for (int run = 1; run <= 3; ++run) {
+        input = makeInput(INPUT_SIZE, run);
+        rerunMapReduceJob(job, client, input, output);
+        freeInput(input);
+        CHECK(checkSums(output, INPUT_SIZE, run));
+    }
+    closeJobHandle(job);
+    CHECK(liveObjects.load() == 0);
+    return true;
+}
+
+/**
+ * Tests that the calling thread maps pairs along with the created workers, and that a job of a
+ * single worker maps every pair on the calling thread, in every reduce mode.
+ */
+static bool testCallerWorks() {
+    for (const bool streaming : {false, true}) {
+        for (const int threads : {1, THREADS}) {
+            const ThreadsClient client;
+            JobConfig config;
+            config.multiThreadLevel = threads;
+            config.streamingReduce = streaming;
+            InputVec input = makeInput(INPUT_SIZE);
+            OutputVec output;
+            JobHandle job = runMapReduceJob(client, input, output, config);
+            closeJobHandle(job);
+            freeInput(input);
+            CHECK(client.mapThreads.count(std::this_thread::get_id()) == 1);
+            CHECK(static_cast<int>(client.mapThreads.size()) <= threads);
+            CHECK(checkSums(output, INPUT_SIZE));
+        }
+    }
+    CHECK(liveObjects.load() == 0);
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"runMapReduceJob", testRunMapReduceJob},
+        {"caller works", testCallerWorks},
+    });
+}
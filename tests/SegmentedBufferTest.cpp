@@ -0,0 +1,124 @@
+/**
+ * Tests of the segmented intermediate buffer's sort, which must not grow the buffer, nor lose a
+ * pair even when a comparison throws.
+ */
+#include <vector>
+#include "TestUtil.h"
+#include "../include/SegmentedBuffer.h"
+
+#define BUFFER_SIZE (3 * SEGMENT_CAPACITY + 17) // Pairs of the tested buffers, spanning four segments
+#define DISTINCT_KEYS 1000 // Distinct keys of the tested buffers, so most keys repeat
+
+static long comparisonsLeft = -1; // Comparisons of CountdownKey before one throws, or -1 for no limit
+static long comparisons = 0; // Comparisons of CountdownKey made so far
+
+/**
+ * An integer key whose comparisons throw once comparisonsLeft runs out.
+ */
+class CountdownKey final : public K2 {
+public:
+    explicit CountdownKey(const int value) : value(value) {}
+
+    bool operator<(const K2& other) const override {
+        ++comparisons;
+        if (comparisonsLeft == 0) {
+            throw std::runtime_error("out of comparisons");
+        }
+        --comparisonsLeft;
+        return value < static_cast<const CountdownKey&>(other).value;
+    }
+
+    int value;
+};
+
+/**
+ * Fills a buffer with BUFFER_SIZE pairs in a fixed pseudo-random order of keys.
+ * @param buffer The buffer, which is empty.
+ * @param keys The keys of the pairs, filled in the order they are added to the buffer.
+ */
+static void fillBuffer(SegmentedBuffer& buffer, std::vector<CountdownKey>& keys) {
+    keys.reserve(BUFFER_SIZE);
+    unsigned state = 12345;
+    for (size_t i = 0; i < BUFFER_SIZE; ++i) {
+        state = state * 1103515245 + 12345;
+        keys.emplace_back(static_cast<int>((state >> 16) % DISTINCT_KEYS));
+        buffer.emplace_back(&keys.back(), nullptr);
+    }
+}
+
+/**
+ * Checks that a buffer holds every key exactly once.
+ * @param buffer The buffer.
+ * @param keys The keys added to the buffer.
+ * @param sorted Whether the buffer must also be in key order.
+ * @return true if the buffer is as expected, false otherwise.
+ */
+static bool checkBuffer(const SegmentedBuffer& buffer, const std::vector<CountdownKey>& keys, const bool sorted) {
+    CHECK(buffer.size() == keys.size());
+    std::vector<int> seen(keys.size(), 0);
+    for (size_t i = 0; i < buffer.size(); ++i) {
+        const auto* key = static_cast<const CountdownKey*>(buffer[i].first);
+        CHECK(!sorted || i == 0 || key->value >= static_cast<const CountdownKey*>(buffer[i - 1].first)->value);
+        ++seen[key - keys.data()];
+    }
+    for (const int count : seen) {
+        CHECK(count == 1);
+    }
+    return true;
+}
+
+/**
+ * Tests the sort of a buffer spanning several segments: the pairs must end up in key order,
+ * with none of them lost or duplicated, in as many segments as they were before.
+ */
+static bool testSort() {
+    SegmentPool pool(SEGMENT_POOL_MAX_CACHED);
+    SegmentedBuffer buffer(&pool);
+    std::vector<CountdownKey> keys;
+    fillBuffer(buffer, keys);
+    const size_t capacity = buffer.capacity();
+    buffer.sort();
+    CHECK(checkBuffer(buffer, keys, true));
+    CHECK(buffer.capacity() == capacity);
+    return true;
+}
+
+/**
+ * Tests sorts whose comparisons throw at several points, both while the segments are sorted and
+ * while they are merged: the buffer must still hold every pair exactly once.
+ */
+static bool testThrowingSort() {
+    SegmentPool pool(SEGMENT_POOL_MAX_CACHED);
+    long total;
+    {
+        SegmentedBuffer buffer(&pool);
+        std::vector<CountdownKey> keys;
+        fillBuffer(buffer, keys);
+        comparisons = 0;
+        buffer.sort();
+        total = comparisons;
+    }
+    for (const long limit : {0L, total / 4, total / 2, total - total / 10, total - 1}) {
+        SegmentedBuffer buffer(&pool);
+        std::vector<CountdownKey> keys;
+        fillBuffer(buffer, keys);
+        comparisonsLeft = limit;
+        bool thrown = false;
+        try {
+            buffer.sort();
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        comparisonsLeft = -1;
+        CHECK(thrown);
+        CHECK(checkBuffer(buffer, keys, false));
+    }
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"sort", testSort},
+        {"throwing sort", testThrowingSort},
+    });
+}
@@ -0,0 +1,121 @@
+/**
+ * Tests of the sorted output, which the workers sort and merge in parallel before a job is done.
+ */
+#include <algorithm>
+#include <vector>
+#include "TestUtil.h"
+
+/**
+ * A client whose map emits the pairs of SumClient, and whose reduce emits a pair keyed by the
+ * value of every intermediate pair, so the output holds many pairs with equal keys.
+ */
+class PairsClient final : public MapReduceClient {
+public:
+    void map(const K1* key, const V1* value, void* context) const override {
+        sum.map(key, value, context);
+    }
+
+    void reduce(const IntermediateVec* pairs, void* context) const override {
+        for (const auto& [key, value] : *pairs) {
+            const long n = static_cast<IntValue*>(value)->value;
+            delete key;
+            delete value;
+            emit3(new IntKey(static_cast<int>(n)), new IntValue(n), context);
+        }
+    }
+
+    void releaseIntermediate(K2* key, V2* value) const override {
+        sum.releaseIntermediate(key, value);
+    }
+
+private:
+    const SumClient sum;
+};
+
+/**
+ * Checks the output of a PairsClient job, and frees it.
+ * @param output The output pairs.
+ * @return true if the output is sorted by key and holds every intermediate pair once, false otherwise.
+ */
+static bool checkSortedPairs(OutputVec& output) {
+    std::vector<size_t> counts(INPUT_SIZE);
+    bool sorted = true;
+    for (size_t i = 0; i < output.size(); ++i) {
+        const int key = static_cast<const IntKey*>(output[i].first)->value;
+        sorted = sorted && (i == 0 || !(*output[i].first < *output[i - 1].first));
+        if (key >= 0 && key < INPUT_SIZE) {
+            ++counts[key];
+        }
+    }
+    bool complete = true;
+    for (size_t value = 0; value < INPUT_SIZE; ++value) {
+        complete = complete && counts[value] == INPUT_SIZE - 1 - value; // Emitted by every larger input value
+    }
+    const size_t expectedSize = INPUT_SIZE * (INPUT_SIZE - 1) / 2;
+    const bool sized = output.size() == expectedSize;
+    freeOutput(output);
+    return sorted && complete && sized;
+}
+
+/**
+ * Tests sorted jobs in every mode, including the output queue: the output must be sorted by key
+ * and complete.
+ */
+static bool testSortedOutput() {
+    const PairsClient client;
+    for (const bool deterministic : {false, true}) {
+        for (const bool streaming : {false, true}) {
+            for (const bool outputQueue : {false, true}) {
+                JobConfig config;
+                config.multiThreadLevel = THREADS;
+                config.deterministic = deterministic;
+                config.streamingReduce = streaming;
+                config.outputQueue = outputQueue;
+                config.sortOutput = true;
+                InputVec input = makeInput(INPUT_SIZE);
+                OutputVec output;
+                JobHandle job = startMapReduceJob(client, input, output, config);
+                waitForJob(job);
+                closeJobHandle(job);
+                freeInput(input);
+                CHECK(checkSortedPairs(output));
+                CHECK(liveObjects.load() == 0);
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Tests sorted runs of a reusable job with a single worker, and with more workers than output pairs.
+ */
+static bool testSortedRuns() {
+    const SumClient client;
+    for (const int threads : {1, KEYS * 2}) {
+        JobConfig config;
+        config.multiThreadLevel = threads;
+        config.sortOutput = true;
+        JobHandle job = createReusableJob(config);
+        for (int run = 1; run <= 2; ++run) {
+            InputVec input = makeInput(INPUT_SIZE * run);
+            OutputVec output;
+            restartMapReduceJob(job, client, input, output);
+            waitForJob(job);
+            freeInput(input);
+            for (size_t i = 0; i < output.size(); ++i) {
+                CHECK(static_cast<const IntKey*>(output[i].first)->value == static_cast<int>(i));
+            }
+            CHECK(checkSums(output, INPUT_SIZE * run));
+        }
+        closeJobHandle(job);
+    }
+    CHECK(liveObjects.load() == 0);
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"sorted output", testSortedOutput},
+        {"sorted runs", testSortedRuns},
+    });
+}
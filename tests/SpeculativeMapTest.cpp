@@ -0,0 +1,104 @@
+/**
+ * Tests of the speculative map, which runs duplicates of straggling map calls and keeps the
+ * output of whichever returns first.
+ */
+#include <chrono>
+#include <thread>
+#include "TestUtil.h"
+
+#define STRAGGLER_INPUT 7 // The input value whose first map call straggles
+#define STRAGGLER_MS 5000 // How long the straggling call runs unless it is superseded
+
+/**
+ * A client which emits the pairs of SumClient, but whose first map call of STRAGGLER_INPUT
+ * straggles until a duplicate of it is kept.
+ */
+class StragglerClient final : public MapReduceClient {
+public:
+    void map(const K1* key, const V1* value, void* context) const override {
+        if (static_cast<const IntValue*>(value)->value == STRAGGLER_INPUT && !straggled.exchange(true)) {
+            const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(STRAGGLER_MS);
+            sum.map(key, value, context); // Pairs that must be discarded once a duplicate is kept
+            while (!isMapSuperseded(context) && std::chrono::steady_clock::now() < end) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            superseded = isMapSuperseded(context);
+            return;
+        }
+        sum.map(key, value, context);
+    }
+
+    void reduce(const IntermediateVec* pairs, void* context) const override {
+        sum.reduce(pairs, context);
+    }
+
+    void releaseIntermediate(K2* key, V2* value) const override {
+        sum.releaseIntermediate(key, value);
+    }
+
+    mutable std::atomic<bool> straggled{false}; // Whether the straggling call started
+    mutable std::atomic<bool> superseded{false}; // Whether the straggling call was superseded
+
+private:
+    const SumClient sum;
+};
+
+/**
+ * Tests speculative jobs with a straggling map call, in every reduce mode: a duplicate of the call
+ * must be kept long before the straggler returns, and the output must hold the pairs of the call
+ * exactly once.
+ */
+static bool testStraggler() {
+    for (const bool streaming : {false, true}) {
+        const StragglerClient client;
+        JobConfig config;
+        config.multiThreadLevel = THREADS;
+        config.streamingReduce = streaming;
+        config.speculativeMap = true;
+        InputVec input = makeInput(INPUT_SIZE);
+        OutputVec output;
+        const auto start = std::chrono::steady_clock::now();
+        JobHandle job = startMapReduceJob(client, input, output, config);
+        waitForJob(job);
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        JobStats stats;
+        getJobStats(job, &stats);
+        closeJobHandle(job);
+        freeInput(input);
+        CHECK(client.superseded);
+        CHECK(stats.speculativeTasks >= 1 && stats.speculativeWins >= 1);
+        CHECK(elapsed < std::chrono::milliseconds(STRAGGLER_MS));
+        CHECK(checkSums(output, INPUT_SIZE));
+        CHECK(liveObjects.load() == 0);
+    }
+    return true;
+}
+
+/**
+ * Tests speculative runs of a reusable job, whose speculation state is reset between runs.
+ */
+static bool testSpeculativeRestarts() {
+    const SumClient client;
+    JobConfig config;
+    config.multiThreadLevel = THREADS;
+    config.speculativeMap = true;
+    JobHandle job = createReusableJob(config);
+    for (int run = 1; run <= 3; ++run) {
+        InputVec input = makeInput(INPUT_SIZE * run);
+        OutputVec output;
+        restartMapReduceJob(job, client, input, output);
+        waitForJob(job);
+        freeInput(input);
+        CHECK(checkSums(output, INPUT_SIZE * run));
+    }
+    closeJobHandle(job);
+    CHECK(liveObjects.load() == 0);
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"straggler", testStraggler},
+        {"speculative restarts", testSpeculativeRestarts},
+    });
+}
@@ -0,0 +1,60 @@
+/**
+ * Tests of the streaming mode, which fuses the shuffle and reduce phases by merging key ranges of
+ * the sorted intermediate vectors straight into reduce.
+ */
+#include "TestUtil.h"
+
+/**
+ * Tests that the output of a streaming job is complete, with one worker (a single key range)
+ * and with several, in both reduce orders.
+ */
+static bool testStreamingOutput() {
+    const SumClient client;
+    for (const int threads : {1, THREADS}) {
+        for (const bool deterministic : {false, true}) {
+            JobConfig config;
+            config.multiThreadLevel = threads;
+            config.streamingReduce = true;
+            config.deterministic = deterministic;
+            InputVec input = makeInput(INPUT_SIZE);
+            OutputVec output;
+            JobHandle job = startMapReduceJob(client, input, output, config);
+            closeJobHandle(job);
+            freeInput(input);
+            CHECK(checkSums(output, INPUT_SIZE));
+            CHECK(liveObjects.load() == 0);
+        }
+    }
+    return true;
+}
+
+/**
+ * Tests that the reduce stage of a streaming job counts intermediate pairs instead of groups.
+ */
+static bool testStreamingProgress() {
+    const SumClient client;
+    JobConfig config;
+    config.multiThreadLevel = THREADS;
+    config.streamingReduce = true;
+    InputVec input = makeInput(INPUT_SIZE);
+    OutputVec output;
+    JobHandle job = startMapReduceJob(client, input, output, config);
+    waitForJob(job);
+    JobState state;
+    getJobState(job, &state);
+    JobMetrics metrics;
+    getJobMetrics(job, &metrics);
+    closeJobHandle(job);
+    freeInput(input);
+    CHECK(checkSums(output, INPUT_SIZE));
+    CHECK(state.stage == REDUCE_STAGE && state.percentage == MAX_PERCENTAGE);
+    CHECK(metrics.processed[REDUCE_STAGE] == static_cast<uint64_t>(INPUT_SIZE) * (INPUT_SIZE - 1) / 2);
+    return true;
+}
+
+int main() {
+    return runTests({
+        {"streaming output", testStreamingOutput},
+        {"streaming progress", testStreamingProgress},
+    });
+}
@@ -0,0 +1,221 @@
+#ifndef TESTUTIL_H
+#define TESTUTIL_H
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "../include/MapReduceFramework.h"
+
+#define KEYS 17 // Distinct intermediate keys emitted by the test client
+#define INPUT_SIZE 200 // Input pairs of the jobs
+#define THREADS 4 // Worker threads of the jobs
+#define POISON_KEY (-1) // A key whose comparisons throw
+#define SHUFFLE_POISON_KEY (-2) // A key whose three-way comparisons throw, which only the shuffle makes
+#define THROWING_REDUCE_KEY 5 // The key of the group whose reduce throws
+
+/**
+ * Fails the calling test, returning false from it, unless the condition holds.
+ */
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            return false; \
+        } \
+    } while (0)
+
+inline std::atomic<long> liveObjects{0}; // Keys and values allocated by the tests and not deleted yet
+
+/**
+ * A base of the tests' keys and values, which counts the live objects, so leaked or
+ * twice-released pairs are caught once a job is closed.
+ */
+class Counted {
+public:
+    Counted() { liveObjects.fetch_add(1, std::memory_order_relaxed); }
+
+    Counted(const Counted&) { liveObjects.fetch_add(1, std::memory_order_relaxed); }
+
+    ~Counted() { liveObjects.fetch_sub(1, std::memory_order_relaxed); }
+};
+
+/**
+ * An integer key, whose comparisons with POISON_KEY throw, as well as its three-way comparisons
+ * with SHUFFLE_POISON_KEY.
+ */
+class IntKey final : public K2, public K3, public Counted {
+public:
+    explicit IntKey(const int value) : value(value) {}
+
+    bool operator<(const K2& other) const override {
+        return less(static_cast<const IntKey&>(other));
+    }
+
+    bool operator<(const K3& other) const override {
+        return less(static_cast<const IntKey&>(other));
+    }
+
+    int compare(const K2& other) const override {
+        const auto& otherKey = static_cast<const IntKey&>(other);
+        if (value == SHUFFLE_POISON_KEY || otherKey.value == SHUFFLE_POISON_KEY) {
+            throw std::runtime_error("poisoned comparison");
+        }
+        return less(otherKey) ? -1 : otherKey.less(*this) ? 1 : 0;
+    }
+
+    int value;
+
+private:
+    [[nodiscard]] bool less(const IntKey& other) const {
+        if (value == POISON_KEY || other.value == POISON_KEY) {
+            throw std::runtime_error("poisoned comparison");
+        }
+        return value < other.value;
+    }
+};
+
+/**
+ * An integer value, used both as an intermediate and as an output value.
+ */
+class IntValue final : public V1, public V2, public V3, public Counted {
+public:
+    explicit IntValue(const long value) : value(value) {}
+
+    long value;
+};
+
+/**
+ * A client which emits the pairs (i % KEYS, i) for every i below the input value, and sums the
+ * values of every key. It owns its intermediate pairs, and releases them when the framework does
+ * not hand them to reduce.
+ */
+class SumClient final : public MapReduceClient {
+public:
+    /**
+     * @param poisonKey A key emitted once on top of the others, or 0 for none.
+     * @param throwingReduce Whether the reduce of THROWING_REDUCE_KEY throws.
+     */
+    explicit SumClient(const int poisonKey = 0, const bool throwingReduce = false)
+        : poisonKey(poisonKey), throwingReduce(throwingReduce) {}
+
+    void map(const K1*, const V1* value, void* context) const override {
+        mapThread = std::this_thread::get_id();
+        const long n = static_cast<const IntValue*>(value)->value;
+        if (poisonKey != 0 && n == 0) {
+            emit2(new IntKey(poisonKey), new IntValue(0), context);
+        }
+        for (long i = 0; i < n; ++i) {
+            emit2(new IntKey(static_cast<int>(i % KEYS)), new IntValue(i), context);
+        }
+    }
+
+    void reduce(const IntermediateVec* pairs, void* context) const override {
+        auto* key = static_cast<IntKey*>(pairs->front().first);
+        long sum = 0;
+        for (const auto& [pairKey, pairValue] : *pairs) {
+            sum += static_cast<IntValue*>(pairValue)->value;
+            if (pairKey != key) {
+                delete pairKey;
+            }
+            delete pairValue;
+        }
+        if (throwingReduce && key->value == THROWING_REDUCE_KEY) {
+            delete key; // The group was handed to reduce, so it is released before throwing
+            throw std::runtime_error("throwing reduce");
+        }
+        emit3(key, new IntValue(sum), context);
+    }
+
+    void releaseIntermediate(K2* key, V2* value) const override {
+        delete key;
+        delete value;
+    }
+
+    mutable std::thread::id mapThread; // The thread of the last map call
+
+private:
+    const int poisonKey;
+    const bool throwingReduce;
+};
+
+/**
+ * Creates the input of a job.
+ * @param size The number of input pairs.
+ * @param offset Added to the value of every input pair.
+ * @return Input pairs whose values are their indices plus the offset.
+ */
+inline InputVec makeInput(const int size, const int offset = 0) {
+    InputVec input;
+    for (int i = 0; i < size; ++i) {
+        input.emplace_back(nullptr, new IntValue(i + offset));
+    }
+    return input;
+}
+
+/**
+ * Frees the input of a job.
+ * @param input The input pairs.
+ */
+inline void freeInput(InputVec& input) {
+    for (auto& [key, value] : input) {
+        delete static_cast<IntValue*>(value);
+    }
+    input.clear();
+}
+
+/**
+ * Frees the output of a job whose keys and values are IntKey and IntValue.
+ * @param output The output pairs.
+ */
+inline void freeOutput(OutputVec& output) {
+    for (auto& [key, value] : output) {
+        delete static_cast<IntKey*>(key);
+        delete static_cast<IntValue*>(value);
+    }
+    output.clear();
+}
+
+/**
+ * Checks the output of a SumClient job, and frees it.
+ * @param output The output pairs.
+ * @param size The number of input pairs.
+ * @param offset The offset of the input values.
+ * @return true if every key has its expected sum, false otherwise.
+ */
+inline bool checkSums(OutputVec& output, const int size, const int offset = 0) {
+    std::map<int, long> expected;
+    for (int n = offset; n < size + offset; ++n) {
+        for (long i = 0; i < n; ++i) {
+            expected[static_cast<int>(i % KEYS)] += i;
+        }
+    }
+    std::map<int, long> actual;
+    for (const auto& [key, value] : output) {
+        actual[static_cast<const IntKey*>(key)->value] += static_cast<const IntValue*>(value)->value;
+    }
+    const bool matches = output.size() == expected.size() && actual == expected;
+    freeOutput(output);
+    return matches;
+}
+
+/**
+ * Runs the tests of a test program, printing a line per test.
+ * @param tests The name and function of every test.
+ * @return The exit status of the program: EXIT_FAILURE if any of the tests failed.
+ */
+inline int runTests(const std::vector<std::pair<const char*, bool (*)()>>& tests) {
+    int failures = 0;
+    for (const auto& [name, test] : tests) {
+        const bool passed = test();
+        std::printf("%s: %s\n", passed ? "PASS" : "FAIL", name);
+        failures += passed ? 0 : 1;
+    }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif //TESTUTIL_H